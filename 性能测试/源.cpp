@@ -0,0 +1,832 @@
+// ĴΪܶԱ
+// ÿһԴļŽԵռ,ͬĺϳڲͬģʹ±Ƚ
+// ÿTickĺʱ,ÿTickĶѷ,ԼÿռõĶڴ
+// ҪRelease,Debugµڶ,Ĳкظڵᴥ,ֱ
+#include <iostream>
+#include <string>
+#include <deque>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <tuple>
+#include <algorithm>
+#include <assert.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// ͳ,滻ȫֵoperator new/delete
+// ÿǰһͷ¼С,ͳƵǰռúͷֵ
+static size_t g_Allocations = 0;
+static size_t g_LiveBytes = 0;
+static size_t g_PeakBytes = 0;
+static const size_t k_HeapHeader = alignof(std::max_align_t);
+
+void *operator new(size_t size)
+{
+	uint8_t *block = static_cast<uint8_t *>(malloc(size + k_HeapHeader));
+	if (block == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+
+	*reinterpret_cast<size_t *>(block) = size;
+	++g_Allocations;
+	g_LiveBytes += size;
+	if (g_LiveBytes > g_PeakBytes)
+	{
+		g_PeakBytes = g_LiveBytes;
+	}
+	return block + k_HeapHeader;
+}
+
+void operator delete(void *p) noexcept
+{
+	if (p == nullptr)
+	{
+		return;
+	}
+
+	uint8_t *block = static_cast<uint8_t *>(p) - k_HeapHeader;
+	g_LiveBytes -= *reinterpret_cast<size_t *>(block);
+	free(block);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+#define main gen1main
+namespace gen1
+{
+#include "../Ϊ/Դ.cpp"
+}
+#undef main
+
+#define main gen2main
+namespace gen2
+{
+#include "../Ϊ2/Դ.cpp"
+}
+#undef main
+
+#define main gen3main
+namespace gen3
+{
+#include "../Ϊ3/Դ.cpp"
+}
+#undef main
+
+#define main gen4main
+namespace gen4
+{
+#include "../Ϊ4/Դ.cpp"
+}
+#undef main
+
+// ϳ,ͬ
+enum eShapeKind
+{
+	SHAPE_WAIT,
+	SHAPE_SEQUENCE,
+	SHAPE_SELECTOR,
+	SHAPE_PARALLEL,
+	SHAPE_REPEAT,
+};
+
+struct SShape
+{
+	SShape(eShapeKind kind, uint32_t param = 0, bool fail = false) :
+		m_Kind(kind),
+		m_Param(param),
+		m_Fail(fail)
+	{
+	}
+
+	// ȴڵΪеĴ,ظڵΪظ
+	eShapeKind m_Kind;
+	uint32_t m_Param;
+	bool m_Fail;
+	std::vector<SShape> m_Children;
+};
+
+// depthǶ׵,һ4εҶ
+SShape makedeep(uint32_t depth)
+{
+	SShape leaf(SHAPE_WAIT, 4);
+	for (uint32_t i = 0; i < depth; ++i)
+	{
+		SShape sequence(SHAPE_SEQUENCE);
+		sequence.m_Children.push_back(leaf);
+		leaf = sequence;
+	}
+	return leaf;
+}
+
+// widthӽڵѡ,ǰĶʧ,һ4
+SShape makewide(uint32_t width)
+{
+	SShape selector(SHAPE_SELECTOR);
+	for (uint32_t i = 1; i < width; ++i)
+	{
+		selector.m_Children.push_back(SShape(SHAPE_WAIT, 0, true));
+	}
+	selector.m_Children.push_back(SShape(SHAPE_WAIT, 4));
+	return selector;
+}
+
+// widthӽڵȫɹĲ,ii
+SShape makeparallel(uint32_t width)
+{
+	SShape parallel(SHAPE_PARALLEL);
+	for (uint32_t i = 1; i <= width; ++i)
+	{
+		parallel.m_Children.push_back(SShape(SHAPE_WAIT, i));
+	}
+	return parallel;
+}
+
+// ظcount1εҶ
+SShape makerepeat(uint32_t count)
+{
+	SShape repeat(SHAPE_REPEAT, count);
+	repeat.m_Children.push_back(SShape(SHAPE_WAIT, 1));
+	return repeat;
+}
+
+struct SResult
+{
+	SResult() :
+		m_Valid(false),
+		m_TickNs(0),
+		m_AllocationsPerTick(0),
+		m_BytesPerAgent(0),
+		m_CompletedPerKTick(0)
+	{
+	}
+
+	bool m_Valid;
+	double m_TickNs;
+	double m_AllocationsPerTick;
+	double m_BytesPerAgent;
+	double m_CompletedPerKTick;	// ÿ1000TickڵɵĴ,ͬ
+};
+
+// ͳһTickѭ,heapBaseΪ֮ǰĶռ
+template <class TICK>
+SResult measure(size_t agents, size_t frames, size_t heapBase, TICK tick)
+{
+	SResult result;
+	size_t completed = 0;
+	size_t allocations = g_Allocations;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t frame = 0; frame < frames; ++frame)
+	{
+		for (size_t i = 0; i < agents; ++i)
+		{
+			completed += tick(i) ? 1 : 0;
+		}
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+	double ticks = static_cast<double>(agents * frames);
+	result.m_Valid = true;
+	result.m_TickNs = ns / ticks;
+	result.m_AllocationsPerTick = (g_Allocations - allocations) / ticks;
+	result.m_BytesPerAgent = static_cast<double>(g_PeakBytes - heapBase) / agents;
+	result.m_CompletedPerKTick = completed * 1000.0 / ticks;
+	return result;
+}
+
+// һ,ÿӵһΪ
+namespace gen1
+{
+	struct CBenchWait :public CBehavior
+	{
+		CBenchWait(uint32_t ticks, eStatus result) :
+			m_Ticks(ticks),
+			m_Remaining(0),
+			m_Result(result)
+		{
+		}
+
+		virtual void OnInitialize()
+		{
+			m_Remaining = m_Ticks;
+		}
+
+		virtual eStatus Update()
+		{
+			if (m_Remaining > 0)
+			{
+				--m_Remaining;
+				return BH_RUNNING;
+			}
+			return m_Result;
+		}
+
+		uint32_t m_Ticks;
+		uint32_t m_Remaining;
+		eStatus m_Result;
+	};
+
+	struct CBenchSequence :public CSequence
+	{
+	};
+
+	struct CBenchSelector :public CSelector
+	{
+	};
+
+	CBehavior *build(const SShape &shape, std::vector<CBehavior *> &owned)
+	{
+		CBehavior *behavior = nullptr;
+		CCompsite *composite = nullptr;
+		switch (shape.m_Kind)
+		{
+		case SHAPE_WAIT:
+			behavior = new CBenchWait(shape.m_Param, shape.m_Fail ? BH_FAILURE : BH_SUCCESS);
+			break;
+		case SHAPE_SEQUENCE:
+			behavior = composite = new CBenchSequence;
+			break;
+		case SHAPE_SELECTOR:
+			behavior = composite = new CBenchSelector;
+			break;
+		case SHAPE_PARALLEL:
+			behavior = composite = new CParallel(CParallel::RequireAll, CParallel::RequireOne);
+			break;
+		case SHAPE_REPEAT:
+		{
+			CRepeat *repeat = new CRepeat(build(shape.m_Children[0], owned));
+			repeat->SetCount(shape.m_Param);
+			behavior = repeat;
+			break;
+		}
+		}
+
+		if (composite != nullptr)
+		{
+			for (size_t i = 0; i < shape.m_Children.size(); ++i)
+			{
+				composite->AddChild(build(shape.m_Children[i], owned));
+			}
+		}
+		owned.push_back(behavior);
+		return behavior;
+	}
+
+	SResult bench(const SShape &shape, size_t agents, size_t frames)
+	{
+		g_PeakBytes = g_LiveBytes;
+		size_t heapBase = g_LiveBytes;
+
+		std::vector<CBehavior *> owned;
+		std::vector<CBehavior *> roots(agents);
+		for (size_t i = 0; i < agents; ++i)
+		{
+			roots[i] = build(shape, owned);
+		}
+
+		SResult result = measure(agents, frames, heapBase, [&](size_t i)
+		{
+			return roots[i]->Tick() != BH_RUNNING;
+		});
+
+		for (size_t i = 0; i < owned.size(); ++i)
+		{
+			delete owned[i];
+		}
+		return result;
+	}
+}
+
+// ڶ,ڵͼ,ÿμʱӶϴ
+namespace gen2
+{
+	struct CBenchWaitTask :public CTask
+	{
+		CBenchWaitTask(CNode &node) :
+			CTask(node),
+			m_Remaining(0)
+		{
+		}
+
+		virtual void OnInitialize();
+		virtual eStatus Update();
+
+		uint32_t m_Remaining;
+	};
+
+	struct CBenchWaitNode :public CNode
+	{
+		CBenchWaitNode(uint32_t ticks, eStatus result) :
+			m_Ticks(ticks),
+			m_Result(result)
+		{
+		}
+
+		virtual CTask *Create()
+		{
+			return new CBenchWaitTask(*this);
+		}
+
+		virtual void Destroy(CTask *task)
+		{
+			delete task;
+		}
+
+		uint32_t m_Ticks;
+		eStatus m_Result;
+	};
+
+	void CBenchWaitTask::OnInitialize()
+	{
+		m_Remaining = static_cast<CBenchWaitNode *>(m_Node)->m_Ticks;
+	}
+
+	eStatus CBenchWaitTask::Update()
+	{
+		if (m_Remaining > 0)
+		{
+			--m_Remaining;
+			return BH_RUNNING;
+		}
+		return static_cast<CBenchWaitNode *>(m_Node)->m_Result;
+	}
+
+	template <class TASK>
+	struct CBenchComposite :public CComposite
+	{
+		virtual CTask *Create()
+		{
+			return new TASK(*this);
+		}
+
+		virtual void Destroy(CTask *task)
+		{
+			delete task;
+		}
+	};
+
+	struct CBenchParallel :public CComposite
+	{
+		virtual CTask *Create()
+		{
+			return new CParallel(*this, CParallel::RequireAll, CParallel::RequireOne);
+		}
+
+		virtual void Destroy(CTask *task)
+		{
+			delete task;
+		}
+	};
+
+	struct CBenchRepeat :public CDecorator
+	{
+		CBenchRepeat(CNode *child, uint32_t count) :
+			CDecorator(child),
+			m_Count(count)
+		{
+		}
+
+		virtual CTask *Create()
+		{
+			CRepeat *repeat = new CRepeat(*this);
+			repeat->SetCount(m_Count);
+			return repeat;
+		}
+
+		virtual void Destroy(CTask *task)
+		{
+			delete task;
+		}
+
+		uint32_t m_Count;
+	};
+
+	CNode *build(const SShape &shape, std::vector<CNode *> &owned)
+	{
+		CNode *node = nullptr;
+		CComposite *composite = nullptr;
+		switch (shape.m_Kind)
+		{
+		case SHAPE_WAIT:
+			node = new CBenchWaitNode(shape.m_Param, shape.m_Fail ? BH_FAILURE : BH_SUCCESS);
+			break;
+		case SHAPE_SEQUENCE:
+			node = composite = new CBenchComposite<CSequence>;
+			break;
+		case SHAPE_SELECTOR:
+			node = composite = new CBenchComposite<CSelector>;
+			break;
+		case SHAPE_PARALLEL:
+			node = composite = new CBenchParallel;
+			break;
+		case SHAPE_REPEAT:
+			node = new CBenchRepeat(build(shape.m_Children[0], owned), shape.m_Param);
+			break;
+		}
+
+		if (composite != nullptr)
+		{
+			for (size_t i = 0; i < shape.m_Children.size(); ++i)
+			{
+				composite->m_Children.push_back(build(shape.m_Children[i], owned));
+			}
+		}
+		owned.push_back(node);
+		return node;
+	}
+
+	SResult bench(const SShape &shape, size_t agents, size_t frames)
+	{
+		std::vector<CNode *> owned;
+		CNode *root = build(shape, owned);
+
+		g_PeakBytes = g_LiveBytes;
+		size_t heapBase = g_LiveBytes;
+		SResult result;
+		{
+			std::deque<CBehavior> behaviors(agents);
+			for (size_t i = 0; i < agents; ++i)
+			{
+				behaviors[i].Setup(*root);
+			}
+
+			result = measure(agents, frames, heapBase, [&](size_t i)
+			{
+				return behaviors[i].Tick() != BH_RUNNING;
+			});
+		}
+
+		for (size_t i = 0; i < owned.size(); ++i)
+		{
+			delete owned[i];
+		}
+		return result;
+	}
+}
+
+// ,ڵ㰴ƫӽڵ,Ҫͬһڴ
+// CBehaviorTreeֻ8KҲܴ,ڵķڵĴCBehaviorAllocate
+namespace gen3
+{
+	struct CBenchWaitTask :public CTask
+	{
+		CBenchWaitTask(CNode &node) :
+			CTask(node),
+			m_Remaining(0)
+		{
+		}
+
+		virtual void OnInitialize();
+		virtual eStatus Update();
+
+		uint32_t m_Remaining;
+	};
+
+	struct CBenchWaitNode :public CNode
+	{
+		CBenchWaitNode(uint32_t ticks, eStatus result) :
+			m_Ticks(ticks),
+			m_Result(result)
+		{
+		}
+
+		virtual CTask *Create()
+		{
+			return new CBenchWaitTask(*this);
+		}
+
+		virtual void Destroy(CTask *task)
+		{
+			delete task;
+		}
+
+		uint32_t m_Ticks;
+		eStatus m_Result;
+	};
+
+	void CBenchWaitTask::OnInitialize()
+	{
+		m_Remaining = static_cast<CBenchWaitNode *>(m_Node)->m_Ticks;
+	}
+
+	eStatus CBenchWaitTask::Update()
+	{
+		if (m_Remaining > 0)
+		{
+			--m_Remaining;
+			return BH_RUNNING;
+		}
+		return static_cast<CBenchWaitNode *>(m_Node)->m_Result;
+	}
+
+	struct CBenchParallel :public CComposite
+	{
+		virtual CTask *Create()
+		{
+			return new CParallel(*this, CParallel::RequireAll, CParallel::RequireOne);
+		}
+
+		virtual void Destroy(CTask *task)
+		{
+			delete task;
+		}
+	};
+
+	struct CBenchRepeat :public CDecorator
+	{
+		CBenchRepeat(CNode *child, uint32_t count) :
+			CDecorator(child),
+			m_Count(count)
+		{
+		}
+
+		virtual CTask *Create()
+		{
+			CRepeat *repeat = new CRepeat(*this);
+			repeat->SetCount(m_Count);
+			return repeat;
+		}
+
+		virtual void Destroy(CTask *task)
+		{
+			delete task;
+		}
+
+		uint32_t m_Count;
+	};
+
+	// ӽڵڸڵ֮
+	CNode &build(const SShape &shape, gen4::CBehaviorAllocate &t)
+	{
+		CComposite *composite = nullptr;
+		switch (shape.m_Kind)
+		{
+		case SHAPE_WAIT:
+			return t.allocate<CBenchWaitNode>(shape.m_Param, shape.m_Fail ? BH_FAILURE : BH_SUCCESS);
+		case SHAPE_SEQUENCE:
+			composite = &t.allocate<CMockSequence>();
+			break;
+		case SHAPE_SELECTOR:
+			composite = &t.allocate<CMockSelector>();
+			break;
+		case SHAPE_PARALLEL:
+			composite = &t.allocate<CBenchParallel>();
+			break;
+		case SHAPE_REPEAT:
+			return t.allocate<CBenchRepeat>(&build(shape.m_Children[0], t), shape.m_Param);
+		}
+
+		for (size_t i = 0; i < shape.m_Children.size(); ++i)
+		{
+			composite->AddChild(build(shape.m_Children[i], t));
+		}
+		return *composite;
+	}
+
+	// ֻk_MaxChildrenPerCompositeӽڵ
+	bool supports(const SShape &shape)
+	{
+		if (shape.m_Children.size() > k_MaxChildrenPerComposite)
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < shape.m_Children.size(); ++i)
+		{
+			if (!supports(shape.m_Children[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	SResult bench(const SShape &shape, size_t agents, size_t frames)
+	{
+		if (!supports(shape))
+		{
+			return SResult();
+		}
+
+		gen4::CBehaviorAllocate t(1 << 20);
+		CNode &root = build(shape, t);
+
+		g_PeakBytes = g_LiveBytes;
+		size_t heapBase = g_LiveBytes;
+		std::deque<CBehavior> behaviors(agents);
+		for (size_t i = 0; i < agents; ++i)
+		{
+			behaviors[i].Setup(root);
+		}
+
+		return measure(agents, frames, heapBase, [&](size_t i)
+		{
+			return behaviors[i].Tick() != BH_RUNNING;
+		});
+	}
+}
+
+// Ĵ,Ԥ,ֱѯ¼ִзʽ
+namespace gen4
+{
+	CNode &build(const SShape &shape, CBehaviorAllocate &t)
+	{
+		CComposite *composite = nullptr;
+		switch (shape.m_Kind)
+		{
+		case SHAPE_WAIT:
+			return t.allocate<CWaitNode>(shape.m_Param, shape.m_Fail ? BH_FAILURE : BH_SUCCESS);
+		case SHAPE_SEQUENCE:
+			composite = &t.allocate<CMockSequence>();
+			break;
+		case SHAPE_SELECTOR:
+			composite = &t.allocate<CMockSelector>();
+			break;
+		case SHAPE_PARALLEL:
+			composite = &t.allocate<CMockParallel>();
+			composite->SetParam(CParallel::MakeParam(CParallel::RequireAll, CParallel::RequireOne));
+			break;
+		case SHAPE_REPEAT:
+		{
+			CMockRepeat &repeat = t.allocate<CMockRepeat>(&build(shape.m_Children[0], t));
+			repeat.SetParam(shape.m_Param);
+			return repeat;
+		}
+		}
+
+		composite->Reserve(t, static_cast<uint16_t>(shape.m_Children.size()));
+		for (size_t i = 0; i < shape.m_Children.size(); ++i)
+		{
+			composite->AddChild(build(shape.m_Children[i], t));
+		}
+		return *composite;
+	}
+
+	// ¼ʱڵֻ֪֪ͨͨ
+	struct SEventAgent
+	{
+		void onComplete(eStatus)
+		{
+			m_Finished = true;
+		}
+
+		CBehaviorTree m_Tree;
+		CBehavior m_Behavior;
+		bool m_Finished;
+	};
+
+	SResult bench(const SShape &shape, size_t agents, size_t frames, bool events)
+	{
+		CBehaviorAllocate t(1 << 20);
+		CNode &root = build(shape, t);
+
+		g_PeakBytes = g_LiveBytes;
+		size_t heapBase = g_LiveBytes;
+		std::deque<SEventAgent> group(agents);
+		for (size_t i = 0; i < agents; ++i)
+		{
+			SEventAgent &agent = group[i];
+			agent.m_Tree.Prepare(root);
+			agent.m_Behavior.Setup(root, &agent.m_Tree);
+			agent.m_Finished = false;
+			if (events)
+			{
+				BehaviorObserver observer = BehaviorObserver::Bind<SEventAgent, &SEventAgent::onComplete>(&agent);
+				agent.m_Tree.Start(agent.m_Behavior, &observer);
+			}
+		}
+
+		if (!events)
+		{
+			return measure(agents, frames, heapBase, [&](size_t i)
+			{
+				return group[i].m_Behavior.Tick() != BH_RUNNING;
+			});
+		}
+
+		return measure(agents, frames, heapBase, [&](size_t i)
+		{
+			SEventAgent &agent = group[i];
+			agent.m_Tree.Tick();
+			if (!agent.m_Finished)
+			{
+				return false;
+			}
+
+			// ڵ¿ʼ,ѯʱԶ³ʼӦ
+			agent.m_Finished = false;
+			agent.m_Tree.Start(agent.m_Behavior);
+			return true;
+		});
+	}
+
+	// ͬһڵͼCFlatTree,ýڵ㰴ͱǩswitch,ֻҶ
+	SResult benchflat(const SShape &shape, size_t agents, size_t frames)
+	{
+		CBehaviorAllocate t(1 << 20);
+		CNode &root = build(shape, t);
+		CFlatTree flat;
+		flat.Build(root);
+
+		g_PeakBytes = g_LiveBytes;
+		size_t heapBase = g_LiveBytes;
+		std::deque<CFlatAgent> group;
+		for (size_t i = 0; i < agents; ++i)
+		{
+			group.emplace_back(flat);
+		}
+
+		return measure(agents, frames, heapBase, [&](size_t i)
+		{
+			return group[i].Tick() != BH_RUNNING;
+		});
+	}
+}
+
+void print(const char *shape, uint32_t size, size_t agents, const char *generation, const SResult &result)
+{
+	if (!result.m_Valid)
+	{
+		printf("%-8s %4u agents=%-6zu %-10s n/a\n", shape, size, agents, generation);
+		return;
+	}
+
+	printf("%-8s %4u agents=%-6zu %-10s ns/tick=%8.1f allocs/tick=%6.2f bytes/agent=%9.0f done/ktick=%6.1f\n",
+		shape, size, agents, generation, result.m_TickNs, result.m_AllocationsPerTick, result.m_BytesPerAgent, result.m_CompletedPerKTick);
+}
+
+int main(int argc, char *argv[])
+{
+	struct SCase
+	{
+		const char *m_Name;
+		SShape(*m_Make)(uint32_t);
+		uint32_t m_Sizes[3];
+	};
+
+	const SCase k_Cases[] =
+	{
+		{ "deep", makedeep, { 4, 16, 64 } },
+		{ "wide", makewide, { 4, 7, 32 } },
+		{ "parallel", makeparallel, { 2, 4, 7 } },
+		{ "repeat", makerepeat, { 4, 32, 256 } },
+	};
+	const size_t k_Agents[] = { 100, 10000 };
+
+	// ÿTick,-quickʱС10
+	size_t ticks = 1000000;
+	if (argc > 1 && strcmp(argv[1], "-quick") == 0)
+	{
+		ticks /= 10;
+	}
+
+	for (size_t c = 0; c < sizeof(k_Cases) / sizeof(k_Cases[0]); ++c)
+	{
+		for (size_t s = 0; s < 3; ++s)
+		{
+			SShape shape = k_Cases[c].m_Make(k_Cases[c].m_Sizes[s]);
+			for (size_t a = 0; a < sizeof(k_Agents) / sizeof(k_Agents[0]); ++a)
+			{
+				size_t agents = k_Agents[a];
+				size_t frames = ticks / agents;
+				const char *name = k_Cases[c].m_Name;
+				uint32_t size = k_Cases[c].m_Sizes[s];
+
+				print(name, size, agents, "gen1", gen1::bench(shape, agents, frames));
+#ifdef NDEBUG
+				print(name, size, agents, "gen2", gen2::bench(shape, agents, frames));
+				print(name, size, agents, "gen3", gen3::bench(shape, agents, frames));
+#else
+				bool asserts = shape.m_Kind == SHAPE_PARALLEL || shape.m_Kind == SHAPE_REPEAT;
+				print(name, size, agents, "gen2", asserts ? SResult() : gen2::bench(shape, agents, frames));
+				print(name, size, agents, "gen3", asserts ? SResult() : gen3::bench(shape, agents, frames));
+#endif
+				print(name, size, agents, "gen4", gen4::bench(shape, agents, frames, false));
+				print(name, size, agents, "gen4-event", gen4::bench(shape, agents, frames, true));
+				print(name, size, agents, "gen4-flat", gen4::benchflat(shape, agents, frames));
+			}
+		}
+	}
+	return 0;
+}
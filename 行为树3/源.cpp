@@ -1,6 +1,8 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <limits>
+#include <cstdint>
 #include <assert.h>
 
 using namespace std;
@@ -409,7 +411,7 @@ public:
 	CMockTask &operator[](uint16_t index)
 	{
 		assert(index < CComposite::GetChildCount());
-		CMockTask *task = static_cast<CMockNode *>(CComposite::GetChild(index))->m_Task;
+		CMockTask *task = static_cast<CMockNode &>(CComposite::GetChild(index)).m_Task;
 		assert(task != nullptr);
 		return *task;
 	}
@@ -1,11 +1,38 @@
-#include <functional>
 #include <deque>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <string>
+#include <tuple>
+#include <algorithm>
 #include <assert.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 using namespace std;
 
 class CNode;
 class CTask;
+class CTaskPool;
+class CBehavior;
+class CBehaviorTree;
 
 enum eStatus
 {
@@ -17,828 +44,9138 @@ enum eStatus
 	BH_SUSPENDED,
 };
 
-typedef std::function<void(eStatus)> BehaviorObserver;
-
-// ڵ
-class CNode
+// ڵ,õ/װνڵռһ,඼Ҷ
+enum eNodeKind
 {
-public:
-	virtual CTask *Create() = 0;
-	virtual void Destroy(CTask *) = 0;
-
-	virtual ~CNode() {}
+	NODE_LEAF,
+	NODE_SEQUENCE,
+	NODE_SELECTOR,
+	NODE_PARALLEL,
+	NODE_MONITOR,
+	NODE_ACTIVESELECTOR,
+	NODE_REPEAT,
 };
 
-// Ϊ
-class CTask
+// Ϊʱ֪ͨ
+// ָֻһ庯,ƺ͵öڴ
+class CBehaviorObserver
 {
 public:
-	CTask(CNode &node) :
-		m_Node(&node)
+	CBehaviorObserver() :
+		m_Object(nullptr),
+		m_Function(nullptr)
 	{
 	}
 
-	virtual ~CTask() {}
+	CBehaviorObserver(void *object, void(*function)(void *, eStatus)) :
+		m_Object(object),
+		m_Function(function)
+	{
+	}
 
-	virtual eStatus Update() = 0;
+	// 󶨳Ա,Bind<CSequence, &CSequence::onChildComplete>(this)
+	template <class T, void (T::*METHOD)(eStatus)>
+	static CBehaviorObserver Bind(T *object)
+	{
+		return CBehaviorObserver(object, &Invoke<T, METHOD>);
+	}
 
-	virtual void OnInitialize() {}
-	virtual void OnTerminate(eStatus) {}
+	void operator()(eStatus status) const
+	{
+		m_Function(m_Object, status);
+	}
+
+	explicit operator bool() const
+	{
+		return m_Function != nullptr;
+	}
 
 protected:
-	CNode * m_Node;
+	template <class T, void (T::*METHOD)(eStatus)>
+	static void Invoke(void *object, eStatus status)
+	{
+		(static_cast<T *>(object)->*METHOD)(status);
+	}
+
+	void *m_Object;
+	void(*m_Function)(void *, eStatus);
 };
 
-// Nodeڴִ
-class CBehavior
+typedef CBehaviorObserver BehaviorObserver;
+
+// ͱ
+// ÿ͵һõʱһ̶±,¼Сͻ±
+// ±ͬʱΪID,CBehavior::Get<TASK>()ݴж,RTTI
+// ǼǱ̶,߳עʱᶯѵǼǵ,ȡ
+class CTaskType
 {
 public:
-	CBehavior() :
-		m_Task(nullptr),
-		m_Node(nullptr),
-		m_Status(BH_INVALID)
-	{
-	}
+	static const size_t k_MaxTypes = 256;
+	static const size_t k_None = 0xFFFF;
 
-	CBehavior(CNode &node) :
-		m_Task(nullptr),
-		m_Node(nullptr),
-		m_Status(BH_INVALID)
+	template <class TASK>
+	static size_t Index()
 	{
-		Setup(node);
+		static_assert(std::is_same<typename TASK::Self, TASK>::value, "task type must declare typedef <itself> Self and typedef <its direct base> Base");
+		static_assert(std::is_base_of<typename TASK::Base, TASK>::value && !std::is_same<typename TASK::Base, TASK>::value, "Base must be a base class of the task");
+		static const size_t index = Register(sizeof(TASK), Index<typename TASK::Base>());
+		return index;
 	}
 
-	~CBehavior()
+	static size_t GetSize(size_t index)
 	{
-		m_Status = BH_INVALID;
-		Teardown();
+		assert(index < GetCount());
+		return Sizes()[index];
 	}
 
-	void Setup(CNode &node)
+	// ±,CTaskΪk_None
+	static size_t GetBase(size_t index)
 	{
-		Teardown();
-
-		m_Node = &node;
-		m_Task = node.Create();
+		assert(index < GetCount());
+		return Bases()[index];
 	}
 
-	void Teardown()
+	// typeǷΪTASK,ȱȽ,Ļ
+	template <class TASK>
+	static bool IsA(size_t type)
 	{
-		if (m_Task == nullptr)
+		size_t index = Index<TASK>();
+		while (type != index && type != k_None)
 		{
-			return;
+			type = GetBase(type);
 		}
-
-		assert(m_Status != BH_RUNNING);
-		m_Node->Destroy(m_Task);
-		m_Task = nullptr;
+		return type == index;
 	}
 
-	eStatus Tick()
+	static size_t GetCount()
 	{
-		if (m_Status != BH_RUNNING)
-		{
-			m_Task->OnInitialize();
-		}
-
-		m_Status = m_Task->Update();
+		return Count().load(std::memory_order_acquire);
+	}
 
-		if (m_Status != BH_RUNNING)
+protected:
+	static size_t Register(size_t size, size_t base)
+	{
+		static std::mutex mutex;
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t index = Count().load(std::memory_order_relaxed);
+		if (index == k_MaxTypes)
 		{
-			m_Task->OnTerminate(m_Status);
+			std::abort();
 		}
-
-		return m_Status;
+		Sizes()[index] = size;
+		Bases()[index] = base;
+		Count().store(index + 1, std::memory_order_release);
+		return index;
 	}
 
-	void Rest()
+	static size_t *Sizes()
 	{
-		m_Status = BH_INVALID;
+		static size_t sizes[k_MaxTypes];
+		return sizes;
 	}
 
-	void Abort()
+	static size_t *Bases()
 	{
-		m_Task->OnTerminate(BH_ABORTED);
-		m_Status = BH_ABORTED;
+		static size_t bases[k_MaxTypes];
+		return bases;
 	}
 
-	bool IsTerminated() const
+	static std::atomic<size_t> &Count()
 	{
-		return m_Status == BH_SUCCESS || m_Status == BH_FAILURE;
+		static std::atomic<size_t> count(0);
+		return count;
 	}
+};
 
-	bool IsRunning() const
+// ڵͼڵͬʱ,ͳ
+struct STaskDemand
+{
+	template <class TASK>
+	void Add(uint32_t count = 1)
 	{
-		return m_Status == BH_RUNNING;
+		size_t index = CTaskType::Index<TASK>();
+		if (index >= m_Counts.size())
+		{
+			m_Counts.resize(index + 1, 0);
+		}
+		m_Counts[index] += count;
 	}
 
-	eStatus GetStatus() const
+	// ӽڵ,ȡ͵ֵ
+	void Max(const STaskDemand &other)
 	{
-		return m_Status;
+		if (other.m_Counts.size() > m_Counts.size())
+		{
+			m_Counts.resize(other.m_Counts.size(), 0);
+		}
+
+		for (size_t i = 0; i < other.m_Counts.size(); ++i)
+		{
+			m_Counts[i] = m_Counts[i] > other.m_Counts[i] ? m_Counts[i] : other.m_Counts[i];
+		}
 	}
 
-	// ȡýڵΪ
-	template <class TASK>
-	TASK *Get()const
+	// ӽڵͬʱ,
+	void Sum(const STaskDemand &other)
 	{
-		return dynamic_cast<TASK *>(m_Task);
+		if (other.m_Counts.size() > m_Counts.size())
+		{
+			m_Counts.resize(other.m_Counts.size(), 0);
+		}
+
+		for (size_t i = 0; i < other.m_Counts.size(); ++i)
+		{
+			m_Counts[i] += other.m_Counts[i];
+		}
 	}
 
-	CTask * m_Task;
-	CNode *m_Node;
-	eStatus m_Status;
-	BehaviorObserver m_Observer;
+	std::vector<uint32_t> m_Counts;
 };
 
-// ԤһƬk_MaxBehaviorTreeMemoryСm_Buffer
-// ÿηʱ,m_Bufferȡһڴ
-const size_t k_MaxBehaviorTreeMemory = 8192;
-class CBehaviorAllocate
+// ڵĺڰ
+struct SDependencies
+{
+	const uint16_t *m_Keys;
+	uint16_t m_Count;
+};
+
+// д
+// 7λһ䳤,С±ͼֻռһֽ
+class CSnapshotWriter
 {
 public:
-	CBehaviorAllocate() :
-		m_Buffer(new uint8_t[k_MaxBehaviorTreeMemory]),
-		m_Offset(0)
+	CSnapshotWriter(std::vector<uint8_t> &buffer) :
+		m_Buffer(buffer)
 	{
 	}
 
-	~CBehaviorAllocate()
+	void Write(uint32_t value)
 	{
-		delete[] m_Buffer;
+		while (value >= 0x80)
+		{
+			m_Buffer.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		m_Buffer.push_back(static_cast<uint8_t>(value));
 	}
 
-	template <typename T>
-	T &allocate()
+	// ԭд,ɶȡԼ֪
+	void WriteBytes(const void *data, size_t size)
 	{
-		T *node = new ((void *)((uintptr_t)m_Buffer + m_Offset)) T;
-		m_Offset += sizeof(T);
-		assert(m_Offset < k_MaxBehaviorTreeMemory);
-		return *node;
+		const uint8_t *bytes = static_cast<const uint8_t *>(data);
+		m_Buffer.insert(m_Buffer.end(), bytes, bytes + size);
 	}
 
 protected:
-	uint8_t * m_Buffer;
-	size_t m_Offset;
+	std::vector<uint8_t> &m_Buffer;
 };
 
-class CBehaviorTree
+// նȡ
+// ݲȡֵΧʱΪʧ,֮Ķ0
+// ownerΪڻָĸΪ,Ҫʱѵָʱҵ
+class CSnapshotReader
 {
 public:
-	void Start(CBehavior &n, BehaviorObserver *observer = nullptr)
+	CSnapshotReader(const uint8_t *data, size_t size, CBehavior *owner = nullptr) :
+		m_Data(data),
+		m_End(data + size),
+		m_Owner(owner),
+		m_Failed(false)
 	{
-		if (observer != nullptr)
-		{
-			n.m_Observer = *observer;
-		}
-		m_Behaviors.push_front(&n);
 	}
 
-	void Stop(CBehavior &n, eStatus result)
+	uint32_t Read()
 	{
-		assert(result != BH_RUNNING);
-		n.m_Status = result;
-
-		if (n.m_Observer)
+		uint32_t value = 0;
+		for (int shift = 0; shift < 35 && m_Data != m_End; shift += 7)
 		{
-			n.m_Observer(result);
+			uint8_t byte = *m_Data++;
+			value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				return value;
+			}
 		}
+		m_Failed = true;
+		return 0;
 	}
 
-	void Tick()
+	// ȡСlimitֵ
+	uint32_t Read(uint32_t limit)
 	{
-		m_Behaviors.push_back(nullptr);
-
-		while (Step())
+		uint32_t value = Read();
+		if (value >= limit)
 		{
-			continue;
+			m_Failed = true;
+			return 0;
 		}
+		return value;
 	}
 
-	bool Step()
+	// ȡsizeֽ,ݲʱnullptr
+	const uint8_t *ReadBytes(size_t size)
 	{
-		CBehavior *current = m_Behaviors.front();
-		m_Behaviors.pop_front();
-
-		if (current == nullptr)
+		if (static_cast<size_t>(m_End - m_Data) < size)
 		{
-			return false;
+			m_Failed = true;
+			return nullptr;
 		}
 
-		current->Tick();
-
-		if (current->m_Status != BH_RUNNING && current->m_Observer)
-		{
-			current->m_Observer(current->m_Status);
-		}
-		else
-		{
-			m_Behaviors.push_back(current);
-		}
-		return true;
+		const uint8_t *bytes = m_Data;
+		m_Data += size;
+		return bytes;
 	}
 
-protected: 
-	std::deque<CBehavior *> m_Behaviors;
-};
-
-// Ϊ
-struct CMockTask :public CTask
-{
-	int m_InitializeCalled;
-	int m_TerminateCalled;
-	int m_UpdateCalled;
-	eStatus m_ReturnStatus;
-	eStatus m_TerminateStatus;
-
-	CMockTask(CNode &node) :
-		CTask(node),
-		m_InitializeCalled(0),
-		m_TerminateCalled(0),
-		m_UpdateCalled(0),
-		m_ReturnStatus(BH_RUNNING),
-		m_TerminateStatus(BH_INVALID)
+	CBehavior *GetOwner() const
 	{
+		return m_Owner;
 	}
 
-	virtual void OnInitialize()
+	bool IsFailed() const
 	{
-		++m_InitializeCalled;
+		return m_Failed;
 	}
 
-	virtual void OnTerminate(eStatus s)
+	bool IsEnd() const
 	{
-		++m_TerminateCalled;
-		m_TerminateStatus = s;
+		return m_Data == m_End;
 	}
 
-	virtual eStatus Update()
-	{
-		++m_UpdateCalled;
-		return m_ReturnStatus;
-	}
+protected:
+	const uint8_t *m_Data;
+	const uint8_t *m_End;
+	CBehavior *m_Owner;
+	bool m_Failed;
 };
 
-// ڵ㹤
-struct CMockNode :public CNode
+// ڵ
+// ڵͼֻĽṹͲ,ֻ,ɱ
+// Լݶ
+class CNode
 {
-	virtual void Destroy(CTask *) {}
-	virtual CTask *Create()
+public:
+	CNode() :
+		m_Param(0)
 	{
-		m_Task = new CMockTask(*this);
-		return m_Task;
 	}
 
-	virtual ~CMockNode()
+	// Ϊbt,btΪʱֱڶϴ
+	virtual CTask *Create(CBehaviorTree *bt) = 0;
+	virtual void Destroy(CTask *) = 0;
+
+	virtual eNodeKind GetKind() const
 	{
-		delete m_Task;
+		return NODE_LEAF;
 	}
 
-	CMockNode() :
-		m_Task(nullptr)
+	// ڵ,ɽڵͽ,ظ,в
+	void SetParam(uint32_t param)
 	{
+		m_Param = param;
 	}
 
-	CMockTask *m_Task;
-};
+	uint32_t GetParam() const
+	{
+		return m_Param;
+	}
 
-void test()
-{
-	CBehaviorAllocate t;
-	CMockNode &n = t.allocate<CMockNode>();
-	CBehavior &b = t.allocate<CBehavior>();
-	b.Setup(n);
+	// ͳԱڵΪͬʱ
+	// /װνڵҪϲӽڵͳ
+	virtual void Measure(STaskDemand &) const
+	{
+	}
 
-	CBehaviorTree bt;
-	bt.Start(b);
-	bt.Tick();
-}
+	// ڵĽֻȡЩڰʱtrue
+	// ѡͼݴֻڼıֵ,δĽڵÿζҪֵ
+	virtual bool GetDependencies(SDependencies &) const
+	{
+		return false;
+	}
 
-// װνڵ㣬ֻһڵ
-class CDecorator :public CNode
-{
-public:
-	CDecorator(CNode *child) :m_Child(child) {}
-	CNode & GetChild() { return *m_Child; }
+	virtual ~CNode() {}
 
 protected:
-	CNode * m_Child;
+	uint32_t m_Param;
 };
 
-// װνڵ㹤
-template <class TASK>
-class CMockDecorator :public CDecorator
+// Ϊ
+class CTask
 {
 public:
-	CMockDecorator(CNode *child) :
-		CDecorator(child)
+	CTask(CNode &node) :
+		m_Node(&node),
+		m_BehaviorTree(nullptr),
+		m_Batched(false),
+		m_EventDriven(false),
+		m_Type(CTaskType::k_None)
 	{
-
 	}
 
-	virtual CTask *Create()
+	virtual ~CTask() {}
+
+	// ÿͶҪֱӻ,CTaskType::Indexڱڼ
+	// ©дʱSelfһ,ʧ,Get<>()м
+	typedef CTask Self;
+	typedef CTask Base;
+
+	static const eNodeKind k_Kind = NODE_LEAF;
+
+	virtual eStatus Update() = 0;
+
+	virtual void OnInitialize() {}
+	virtual void OnTerminate(eStatus) {}
+
+	// CBehaviorTree::Start,ownerΪбΪ
+	// trueʾӽڵ¼ƽ,ȶ
+	virtual bool OnStart(CBehavior &)
 	{
-		return new TASK(*this);
+		return false;
 	}
 
-	virtual void Destroy(CTask *task)
+	// ״̬,ֻлʱ
+	virtual void Save(CSnapshotWriter &) const
 	{
-		delete task;
 	}
-};
 
-// ظ
-class CRepeat :public CTask
-{
-public:
-	CRepeat(CDecorator &node) :CTask(node) {}
+	// ½ϻָSave״̬,ݲʱfalse
+	// Ĭϲ״̬,ָʱ³ʼ,൱ҶӶͷʼ
+	virtual bool Load(CSnapshotReader &)
+	{
+		OnInitialize();
+		return true;
+	}
 
-	CDecorator &GetNode()
+	// Ĵ
+	CBehaviorTree *GetBehaviorTree() const
 	{
-		return *static_cast<CDecorator*>(m_Node);
+		return m_BehaviorTree;
 	}
 
-	void SetCount(int count)
+	void SetBehaviorTree(CBehaviorTree *bt)
 	{
-		m_Limit = count;
+		m_BehaviorTree = bt;
 	}
 
-	virtual void OnInitialize()
+	// Ҷ,CBatchTask
+	bool IsBatched() const
 	{
-		m_Counter = 0;
-		m_Behavior.Setup(GetNode().GetChild());
+		return m_Batched;
 	}
 
-	virtual eStatus Update()
+	// CBehaviorTree::StartOnStarttrueʱ,֮ӽڵ¼ƽ
+	bool IsEventDriven() const
 	{
-		for (;;)
-		{
-			m_Behavior.Tick();
-			if (m_Behavior.GetStatus() == BH_RUNNING) break;
-			if (m_Behavior.GetStatus() == BH_FAILURE) return BH_FAILURE;
-			if (++m_Counter == m_Limit) return BH_SUCCESS;
-			m_Behavior.Rest();
-		}
-		return BH_INVALID;
+		return m_EventDriven;
 	}
 
-protected:
-	int m_Limit;
-	int m_Counter;
-	CBehavior m_Behavior;
-};
+	void SetEventDriven(bool eventDriven)
+	{
+		m_EventDriven = eventDriven;
+	}
 
-typedef CMockDecorator<CRepeat> CMockRepeat;
+	// ID,CTaskType±,CreateTask¼
+	size_t GetType() const
+	{
+		return m_Type;
+	}
 
-void testrepeat()
+	void SetType(size_t type)
+	{
+		m_Type = static_cast<uint16_t>(type);
+	}
+
+protected:
+	CNode * m_Node;
+	CBehaviorTree *m_BehaviorTree;
+	bool m_Batched;
+	bool m_EventDriven;
+	uint16_t m_Type;
+};
+
+// CTaskյ
+template <>
+inline size_t CTaskType::Index<CTask>()
 {
-	CBehaviorTree bt;
-	CBehaviorAllocate t;
-	CMockNode &n = t.allocate<CMockNode>();
-	CMockRepeat re(&n);
-	CBehavior b(re);
-	b.Get<CRepeat>()->SetCount(3);
-	b.Tick();
-}
+	static const size_t index = Register(sizeof(CTask), k_None);
+	return index;
+};
 
-const size_t k_MaxChildrenPerComposite = 7;
-// Ͻڵ㣬ӵжӽڵ
-class CComposite :public CNode
+// 
+// ÿһ,ReserveڵͼͳưԤһڴ
+// Create/Destroyֻȡ,ȶʱٷȫֶ
+class CTaskPool
 {
 public:
-	CComposite() :
-		m_ChildCount(0),
-		m_BehaviorTree(nullptr)
+	CTaskPool() :
+		m_Hits(0),
+		m_Misses(0),
+		m_ReservedSize(0)
 	{
 	}
 
-	void AddChild(CNode &child)
+	~CTaskPool()
 	{
-		assert(m_ChildCount < k_MaxChildrenPerComposite);
-		ptrdiff_t p = (uintptr_t)&child - (uintptr_t)this;
-		assert(p < std::numeric_limits<uint16_t>::max());
-		m_Children[m_ChildCount++] = static_cast<uint16_t>(p);
+		for (size_t i = 0; i < m_Blocks.size(); ++i)
+		{
+			::operator delete(m_Blocks[i]);
+		}
 	}
 
-	void AddChildFront(CNode &child)
+	// ͳƽһԤڴ
+	void Reserve(const STaskDemand &demand)
 	{
-		assert(m_ChildCount < k_MaxChildrenPerComposite);
-		ptrdiff_t p = (uintptr_t)&child - (uintptr_t)this;
-		assert(p < std::numeric_limits<uint16_t>::max());
+		size_t size = 0;
+		for (size_t type = 0; type < demand.m_Counts.size(); ++type)
+		{
+			size += Align(CTaskType::GetSize(type)) * demand.m_Counts[type];
+		}
+
+		if (size == 0)
+		{
+			return;
+		}
 
-		for (uint16_t i = m_ChildCount; i > 0; --i)
+		uint8_t *block = static_cast<uint8_t *>(::operator new(size));
+		m_Blocks.push_back(block);
+		m_ReservedSize += size;
+
+		for (size_t type = 0; type < demand.m_Counts.size(); ++type)
 		{
-			m_Children[i] = m_Children[i - 1];
+			for (uint32_t i = 0; i < demand.m_Counts[type]; ++i)
+			{
+				Push(type, block);
+				block += Align(CTaskType::GetSize(type));
+			}
 		}
-		m_Children[0] = static_cast<uint16_t>(p);
 	}
 
-	CNode &GetChild(uint16_t index)
+	template <class TASK, class NODE>
+	TASK *Create(NODE &node)
 	{
-		assert(index < m_ChildCount);
-		return *(CNode*)((uintptr_t)this + m_Children[index]);
+		void *p = Pop(CTaskType::Index<TASK>());
+		if (p != nullptr)
+		{
+			++m_Hits;
+		}
+		else
+		{
+			// Ԥ,Ӷϲһ,黹и
+			++m_Misses;
+			p = ::operator new(sizeof(TASK));
+			m_Blocks.push_back(p);
+			m_ReservedSize += sizeof(TASK);
+		}
+		return new (p) TASK(node);
 	}
 
-	uint16_t GetChildCount() const
+	template <class TASK>
+	void Destroy(CTask *task)
 	{
-		return m_ChildCount;
+		static_cast<TASK *>(task)->~TASK();
+		Push(CTaskType::Index<TASK>(), task);
 	}
 
-public:
-	uint16_t m_Children[k_MaxChildrenPerComposite];
-	uint16_t m_ChildCount;
-	CBehaviorTree *m_BehaviorTree;
-};
-
-// Ͻڵ㹤
-template <class TASK>
-class CMockComposite :public CComposite
-{
-public:
-	void Initialize(CBehaviorTree &bt, CBehaviorAllocate &tree, size_t size)
+	// ӽڵ仯
+	// Сȡ2ݷּ,ÿһ,һδӶ,黹
+	void *AllocateArray(size_t size)
 	{
-		CComposite::m_BehaviorTree = &bt;
-		for (size_t i = 0; i < size; ++i)
+		size_t level = ArrayLevel(size);
+		if (level < m_ArrayLists.size() && m_ArrayLists[level] != nullptr)
 		{
-			CMockNode &n = tree.allocate<CMockNode>();
-			CComposite::AddChild(n);
+			FreeNode *node = m_ArrayLists[level];
+			m_ArrayLists[level] = node->m_Next;
+			++m_Hits;
+			return node;
 		}
+
+		++m_Misses;
+		void *p = ::operator new(size_t(1) << level);
+		m_Blocks.push_back(p);
+		m_ReservedSize += size_t(1) << level;
+		return p;
 	}
 
-	CMockTask &operator[](uint16_t index)
+	void FreeArray(void *p, size_t size)
 	{
-		assert(index < CComposite::GetChildCount());
-		CMockTask *task = static_cast<CMockNode *>(CComposite::GetChild(index))->m_Task;
-		assert(task != nullptr);
-		return *task;
+		size_t level = ArrayLevel(size);
+		if (level >= m_ArrayLists.size())
+		{
+			m_ArrayLists.resize(level + 1, nullptr);
+		}
+
+		FreeNode *node = static_cast<FreeNode *>(p);
+		node->m_Next = m_ArrayLists[level];
+		m_ArrayLists[level] = node;
 	}
 
-	virtual CTask *Create()
+	// ӿȡĴ
+	size_t GetHits() const
 	{
-		return new TASK(*this);
+		return m_Hits;
 	}
 
-	virtual void Destroy(CTask *task)
+	// ȫֶѵĴ
+	size_t GetMisses() const
 	{
-		delete task;
+		return m_Misses;
 	}
 
-};
-
-// нڵ
-// ˳,һʧ,򷵻
-// Ҫгɹ,򷵻سɹ,򷵻ʧ
-class CSequence :public CTask
-{
-public:
-	CSequence(CComposite &node) :
-		CTask(node)
+	// Ϊֽ
+	size_t GetReservedSize() const
 	{
-		m_BehaviorTree = node.m_BehaviorTree;
+		return m_ReservedSize;
 	}
 
-	CComposite &GetNode()
+	void ResetCounters()
 	{
-		return *static_cast<CComposite *>(m_Node);
+		m_Hits = 0;
+		m_Misses = 0;
 	}
 
-	virtual void OnInitialize()
+protected:
+	struct FreeNode
 	{
-		m_CurrentIndex = 0;
-		m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex));
-		BehaviorObserver observer = std::bind(&CSequence::onChildComplete, this, std::placeholders::_1);
+		FreeNode *m_Next;
+	};
+
+	static size_t Align(size_t size)
+	{
+		const size_t align = alignof(std::max_align_t);
+		return (size + align - 1) & ~(align - 1);
 	}
 
-	void onChildComplete(eStatus)
+	// Сsize2ݵָ,ܷһFreeNode
+	static size_t ArrayLevel(size_t size)
 	{
-		CBehavior &child = m_CurrentBehavior;
-		if (child.m_Status == BH_FAILURE)
+		size_t level = 0;
+		while ((size_t(1) << level) < size || (size_t(1) << level) < sizeof(FreeNode))
 		{
-			m_BehaviorTree->Stop(child, BH_FAILURE);
-			return;
+			++level;
 		}
+		return level;
+	}
 
-		assert(child.m_Status == BH_SUCCESS);
-		if (++m_CurrentIndex == GetNode().GetChildCount())
-		{
-			m_BehaviorTree->Stop(child, BH_SUCCESS);
-		}
-		else
+	void Push(size_t type, void *p)
+	{
+		if (type >= m_FreeLists.size())
 		{
-			BehaviorObserver observer = std::bind(&CSequence::onChildComplete, this, std::placeholders::_1);
-			m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex));
-			m_BehaviorTree->Start(m_CurrentBehavior, &observer);
+			m_FreeLists.resize(type + 1, nullptr);
 		}
+
+		FreeNode *node = static_cast<FreeNode *>(p);
+		node->m_Next = m_FreeLists[type];
+		m_FreeLists[type] = node;
 	}
 
-	virtual eStatus Update()
+	void *Pop(size_t type)
 	{
-		for (;;)
+		if (type >= m_FreeLists.size() || m_FreeLists[type] == nullptr)
 		{
-			eStatus s = m_CurrentBehavior.Tick();
-
-			if (s != BH_SUCCESS)
-			{
-				// ɹˣһ򷵻
-				return s;
-			}
-
-			if (++m_CurrentIndex == GetNode().GetChildCount())
-			{
-				// нڵгɹ
-				return BH_SUCCESS;
-			}
-
-			m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex));
+			return nullptr;
 		}
+
+		FreeNode *node = m_FreeLists[type];
+		m_FreeLists[type] = node->m_Next;
+		return node;
 	}
 
-	CBehavior m_CurrentBehavior;
-	uint16_t m_CurrentIndex;
-	CBehaviorTree* m_BehaviorTree;
+	std::vector<FreeNode *> m_FreeLists;
+	std::vector<FreeNode *> m_ArrayLists;
+	std::vector<void *> m_Blocks;
+	size_t m_Hits;
+	size_t m_Misses;
+	size_t m_ReservedSize;
 };
 
-typedef CMockComposite<CSequence> CMockSequence;
+// ͳ
+// BH_PROFILEΪ1ʱ,Ϊ0ʱͳƴ붼
+// ڵͳTick,/ӽڵĺʱ,״̬ĴԼĴ/ٴ
+// ͳ̰߳,߳ʱÿ̸߳һ,Mergeϲ
+#ifndef BH_PROFILE
+#define BH_PROFILE 0
+#endif
 
-void testsequence()
-{
-	CBehaviorTree bt;
-	CBehaviorAllocate t;
-	CMockSequence &se = t.allocate<CMockSequence>();
+#if BH_PROFILE
 
-	se.Initialize(bt,t, 2);
+// ʱԴڼ,֧ʱ˻صsteady_clock
+inline uint64_t ReadCycles()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
 
-	CBehavior b;
-	b.Setup(se);
+struct SNodeProfile
+{
+	uint64_t m_Calls;
+	uint64_t m_Inclusive;	// ӽڵĺʱ
+	uint64_t m_Exclusive;	// ӽڵĺʱ
+	uint64_t m_Status[BH_SUSPENDED + 1];
+	uint64_t m_Created;
+	uint64_t m_Destroyed;
+};
 
-	bt.Start(b);
-	bt.Tick();
-}
+class CProfileScope;
 
-// ѡ׶
-// ˳,һɹֱӷ
-// ֻҪһгɹ,򷵻سɹ,򷵻ʧ
-class CSelector :public CTask
+class CProfiler
 {
 public:
-	CSelector(CComposite &node) :
-		CTask(node)
+	CProfiler() :
+		m_Scope(nullptr)
 	{
 	}
 
-protected:
-	CComposite & GetNode()
+	// ǰ߳ʹõͳ,Ϊʱͳ
+	static CProfiler *GetCurrent()
 	{
-		return *static_cast<CComposite*>(m_Node);
+		return Current();
 	}
 
-	virtual void OnInitialize()
+	static void SetCurrent(CProfiler *profiler)
 	{
-		m_CurrentIndex = 0;
-		m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex));
+		Current() = profiler;
 	}
 
-	virtual eStatus Update()
+	// ûм¼Ľڵ㷵ȫ0
+	SNodeProfile Get(const CNode &node) const
 	{
-		for (;;)
-		{
-			eStatus s = m_CurrentBehavior.Tick();
+		std::unordered_map<const CNode *, SNodeProfile>::const_iterator it = m_Nodes.find(&node);
+		return it != m_Nodes.end() ? it->second : SNodeProfile();
+	}
 
-			if (s != BH_FAILURE)
-			{
-				// ʧˣһ򷵻
-				return s;
-			}
+	SNodeProfile &Record(const CNode &node)
+	{
+		return m_Nodes[&node];
+	}
 
-			if (++m_CurrentIndex == GetNode().GetChildCount())
+	void Merge(const CProfiler &other)
+	{
+		for (std::unordered_map<const CNode *, SNodeProfile>::const_iterator it = other.m_Nodes.begin(); it != other.m_Nodes.end(); ++it)
+		{
+			SNodeProfile &p = m_Nodes[it->first];
+			p.m_Calls += it->second.m_Calls;
+			p.m_Inclusive += it->second.m_Inclusive;
+			p.m_Exclusive += it->second.m_Exclusive;
+			for (int i = 0; i <= BH_SUSPENDED; ++i)
 			{
-				// нڵʧ
-				return BH_FAILURE;
+				p.m_Status[i] += it->second.m_Status[i];
 			}
-
-			m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex));
+			p.m_Created += it->second.m_Created;
+			p.m_Destroyed += it->second.m_Destroyed;
 		}
 	}
 
-	CBehavior m_CurrentBehavior;
-	uint16_t m_CurrentIndex;
-};
-
-typedef CMockComposite<CSelector> CMockSelector;
-
-void testselector()
-{
-	CBehaviorTree bt;
-	CBehaviorAllocate t;
-	CMockSelector &se = t.allocate<CMockSelector>();
-	se.Initialize(bt, t, 2);
-	CBehavior b(se);
-	bt.Start(b);
-	bt.Tick();
-}
-
-// нڵ
-// ȫ,ɹʧܸʱ,
-// ʧӦڳɹ
-class CParallel :public CTask
-{
-public:
-	enum ePolicy
-	{
-		RequireOne,	//
-		RequireAll,	//ȫ
-	};
-
-	CParallel(CComposite &node) :
-		CTask(node)
+	void Clear()
 	{
+		m_Nodes.clear();
 	}
 
+	// rootʼ,idΪ˳,parentΪڵid,ڵΪ-1
+	void DumpCSV(FILE *file, const CNode &root) const;
+	void DumpJSON(FILE *file, const CNode &root) const;
 
-	// ɹ,ʧ
-	CParallel(CComposite &node, ePolicy forSuccess, ePolicy forFailure) :
-		m_SuccessPolicy(forSuccess),
-		m_FailruePolicy(forFailure),
-		CTask(node)
+	static void OnCreate(const CNode &node)
 	{
-
+		if (CProfiler *profiler = Current())
+		{
+			++profiler->Record(node).m_Created;
+		}
 	}
 
-	void SetPolicy(ePolicy forSuccess, ePolicy forFailure)
+	static void OnDestroy(const CNode &node)
 	{
-		m_SuccessPolicy = forSuccess;
-		m_FailruePolicy = forFailure;
+		if (CProfiler *profiler = Current())
+		{
+			++profiler->Record(node).m_Destroyed;
+		}
 	}
 
-	CComposite &GetNode()
+	static void OnAbort(const CNode &node)
 	{
-		return *static_cast<CComposite*>(m_Node);
+		if (CProfiler *profiler = Current())
+		{
+			++profiler->Record(node).m_Status[BH_ABORTED];
+		}
 	}
 
 protected:
-	virtual eStatus Update()
+	friend class CProfileScope;
+
+	struct SEntry
 	{
-		size_t nSuccessCount = 0, nFailureCount = 0;
-		for (uint16_t i = 0; i < GetNode().GetChildCount(); ++i)
-		{
-			m_Behavior.Setup(GetNode().GetChild(i));
-			if (!m_Behavior.IsTerminated())
-			{
-				m_Behavior.Tick();
-			}
+		const CNode *m_Node;
+		int m_Parent;
+	};
 
-			if (m_Behavior.GetStatus() == BH_SUCCESS)
-			{
-				// ɹһ
-				++nSuccessCount;
-				if (m_SuccessPolicy == RequireOne)
-				{
-					// ֻҪһγɹ򷵻سɹ
-					return BH_SUCCESS;
-				}
-			}
+	static CProfiler *&Current()
+	{
+		static thread_local CProfiler *profiler = nullptr;
+		return profiler;
+	}
 
-			if (m_Behavior.GetStatus() == BH_FAILURE)
-			{
-				// ʧһ
-				++nFailureCount;
-				if (m_FailruePolicy == RequireOne)
-				{
-					// ֻҪʧһ򷵻ʧ
-					return BH_FAILURE;
-				}
-			}
-			m_Behavior.Rest();
-		}
+	static void Walk(const CNode &node, int parent, std::vector<SEntry> &entries);
 
-		if (m_FailruePolicy == RequireAll && nFailureCount == GetNode().GetChildCount())
+	std::unordered_map<const CNode *, SNodeProfile> m_Nodes;
+	CProfileScope *m_Scope;	// Tickڲڵ
+};
+
+// һTickļʱ,Ƕ׵ӽڵʱӸڵĶռʱп۳
+class CProfileScope
+{
+public:
+	CProfileScope(const CNode &node) :
+		m_Profiler(CProfiler::Current()),
+		m_Node(&node),
+		m_Status(BH_INVALID),
+		m_Children(0)
+	{
+		if (m_Profiler != nullptr)
 		{
-			// ȫʧ
-			return BH_FAILURE;
+			m_Parent = m_Profiler->m_Scope;
+			m_Profiler->m_Scope = this;
+			m_Start = ReadCycles();
 		}
+	}
 
-		if (m_SuccessPolicy == RequireAll && nSuccessCount == GetNode().GetChildCount())
+	~CProfileScope()
+	{
+		if (m_Profiler == nullptr)
 		{
-			// ȫɹ
-			return BH_SUCCESS;
+			return;
 		}
 
-		// нڵ㴦Running
-		return BH_RUNNING;
-	}
+		uint64_t elapsed = ReadCycles() - m_Start;
+		SNodeProfile &p = m_Profiler->Record(*m_Node);
+		++p.m_Calls;
+		p.m_Inclusive += elapsed;
+		p.m_Exclusive += elapsed > m_Children ? elapsed - m_Children : 0;
+		++p.m_Status[m_Status];
 
-	virtual void OnTerminate(eStatus)
-	{
-		for (uint16_t i = 0; i < GetNode().GetChildCount(); ++i)
+		m_Profiler->m_Scope = m_Parent;
+		if (m_Parent != nullptr)
 		{
-			m_Behavior.Setup(GetNode().GetChild(i));
-			if (m_Behavior.IsRunning())
-			{
-				m_Behavior.Abort();
-			}
+			m_Parent->m_Children += elapsed;
 		}
 	}
 
+	void SetStatus(eStatus status)
+	{
+		m_Status = status;
+	}
+
+protected:
+	CProfiler *m_Profiler;
+	CProfileScope *m_Parent;
+	const CNode *m_Node;
+	eStatus m_Status;
+	uint64_t m_Start;
+	uint64_t m_Children;
+};
+
+#define BH_PROFILE_TICK(node) CProfileScope profileScope(node)
+#define BH_PROFILE_STATUS(status) profileScope.SetStatus(status)
+#define BH_PROFILE_CREATE(node) CProfiler::OnCreate(node)
+#define BH_PROFILE_DESTROY(node) CProfiler::OnDestroy(node)
+#define BH_PROFILE_ABORT(node) CProfiler::OnAbort(node)
+
+#else
+
+#define BH_PROFILE_TICK(node) ((void)0)
+#define BH_PROFILE_STATUS(status) ((void)0)
+#define BH_PROFILE_CREATE(node) ((void)0)
+#define BH_PROFILE_DESTROY(node) ((void)0)
+#define BH_PROFILE_ABORT(node) ((void)0)
+
+#endif
+
+// Nodeڴִ
+class CBehavior
+{
+public:
+	CBehavior() :
+		m_Task(nullptr),
+		m_Node(nullptr),
+		m_Status(BH_INVALID)
+	{
+	}
+
+	CBehavior(CNode &node, CBehaviorTree *bt = nullptr) :
+		m_Task(nullptr),
+		m_Node(nullptr),
+		m_Status(BH_INVALID)
+	{
+		Setup(node, bt);
+	}
+
+	~CBehavior()
+	{
+		m_Status = BH_INVALID;
+		Teardown();
+	}
+
+	// Ӵbtд
+	void Setup(CNode &node, CBehaviorTree *bt = nullptr)
+	{
+		Teardown();
+
+		m_Node = &node;
+		m_Task = node.Create(bt);
+		BH_PROFILE_CREATE(node);
+	}
+
+	void Teardown()
+	{
+		if (m_Task == nullptr)
+		{
+			return;
+		}
+
+		assert(!IsActive());
+		BH_PROFILE_DESTROY(*m_Node);
+		m_Node->Destroy(m_Task);
+		m_Task = nullptr;
+	}
+
+	eStatus Tick()
+	{
+		BH_PROFILE_TICK(*m_Node);
+
+		// ΪָUpdate,³ʼ,ʱҲ
+		if (m_Status != BH_RUNNING && m_Status != BH_SUSPENDED)
+		{
+			m_Task->OnInitialize();
+		}
+
+		m_Status = m_Task->Update();
+
+		if (m_Status != BH_RUNNING && m_Status != BH_SUSPENDED)
+		{
+			m_Task->OnTerminate(m_Status);
+		}
+
+		BH_PROFILE_STATUS(m_Status);
+		return m_Status;
+	}
+
+	void Rest()
+	{
+		m_Status = BH_INVALID;
+	}
+
+	// ֻ¼״̬,лʱ¼Լ״̬
+	void Save(CSnapshotWriter &writer) const
+	{
+		writer.Write(m_Status);
+		if (IsActive())
+		{
+			m_Task->Save(writer);
+		}
+	}
+
+	// ΪSetup뱣ʱͬĽڵ,½
+	// ʧʱ״̬ΪBH_INVALID,Ϊͣڰ;,Setup,LoadSnapshot
+	bool Load(CSnapshotReader &reader)
+	{
+		m_Status = BH_INVALID;
+		eStatus status = static_cast<eStatus>(reader.Read(BH_SUSPENDED + 1));
+		if (reader.IsFailed())
+		{
+			return false;
+		}
+
+		if (status == BH_RUNNING || status == BH_SUSPENDED)
+		{
+			if (!m_Task->Load(reader) || reader.IsFailed())
+			{
+				return false;
+			}
+		}
+		m_Status = status;
+		return true;
+	}
+
+	// Ϊ״̬,
+	void Swap(CBehavior &other)
+	{
+		std::swap(m_Task, other.m_Task);
+		std::swap(m_Node, other.m_Node);
+		std::swap(m_Status, other.m_Status);
+		std::swap(m_Observer, other.m_Observer);
+	}
+
+	void Abort()
+	{
+		BH_PROFILE_ABORT(*m_Node);
+		m_Task->OnTerminate(BH_ABORTED);
+		m_Status = BH_ABORTED;
+	}
+
+	bool IsTerminated() const
+	{
+		return m_Status == BH_SUCCESS || m_Status == BH_FAILURE;
+	}
+
+	bool IsRunning() const
+	{
+		return m_Status == BH_RUNNING;
+	}
+
+	bool IsSuspended() const
+	{
+		return m_Status == BH_SUSPENDED;
+	}
+
+	// л,ʱҪAbort
+	bool IsActive() const
+	{
+		return m_Status == BH_RUNNING || m_Status == BH_SUSPENDED;
+	}
+
+	eStatus GetStatus() const
+	{
+		return m_Status;
+	}
+
+	// ȡýڵΪ
+	// ȽIDstatic_cast,ҪRTTI
+	template <class TASK>
+	TASK *Get()const
+	{
+		if (m_Task == nullptr || !CTaskType::IsA<TASK>(m_Task->GetType()))
+		{
+			return nullptr;
+		}
+		return static_cast<TASK *>(m_Task);
+	}
+
+	CTask * m_Task;
+	CNode *m_Node;
+	eStatus m_Status;
+	BehaviorObserver m_Observer;
+};
+
+// k_MaxBehaviorTreeMemoryСĿΪλԤڴ
+// ÿηʱ,ӵǰ鰴alignof(T)ȡһڴ,¿
+// ƽĶ¼,resetʱ
+const size_t k_MaxBehaviorTreeMemory = 8192;
+class CBehaviorAllocate
+{
+public:
+	CBehaviorAllocate(size_t blockSize = k_MaxBehaviorTreeMemory) :
+		m_BlockSize(blockSize),
+		m_First(nullptr),
+		m_Current(nullptr),
+		m_Offset(0),
+		m_Used(0),
+		m_Finalizers(nullptr)
+	{
+	}
+
+	~CBehaviorAllocate()
+	{
+		reset();
+
+		while (m_First != nullptr)
+		{
+			Block *next = m_First->m_Next;
+			::operator delete(m_First);
+			m_First = next;
+		}
+	}
+
+	template <typename T, typename... ARGS>
+	T &allocate(ARGS &&... args)
+	{
+		Finalizer *finalizer = nullptr;
+		if (!std::is_trivially_destructible<T>::value)
+		{
+			finalizer = static_cast<Finalizer *>(allocate(sizeof(Finalizer), alignof(Finalizer)));
+		}
+
+		T *node = new (allocate(sizeof(T), alignof(T))) T(std::forward<ARGS>(args)...);
+
+		if (finalizer != nullptr)
+		{
+			finalizer->m_Destroy = &Destroy<T>;
+			finalizer->m_Object = node;
+			finalizer->m_Next = m_Finalizers;
+			m_Finalizers = finalizer;
+		}
+		return *node;
+	}
+
+	// ȡsizeС,alignԭʼڴ
+	void *allocate(size_t size, size_t align)
+	{
+		assert(align != 0 && (align & (align - 1)) == 0);
+
+		if (m_Current != nullptr)
+		{
+			size_t offset = AlignOffset(m_Current, m_Offset, align);
+			if (offset + size <= m_Current->m_Size)
+			{
+				return Take(offset, size);
+			}
+		}
+
+		// ǰ鲻,ȸresetǰµĿ
+		Block *next = m_Current != nullptr ? m_Current->m_Next : m_First;
+		if (next == nullptr || AlignOffset(next, 0, align) + size > next->m_Size)
+		{
+			next = NewBlock(size + align, next);
+		}
+		m_Current = next;
+		m_Offset = 0;
+		return Take(AlignOffset(m_Current, 0, align), size);
+	}
+
+	// ûʱ,ǡsizeСĵһ,֮sizeķ䶼һ
+	void reserve(size_t size)
+	{
+		if (m_First == nullptr)
+		{
+			AddBlock(size, nullptr);
+		}
+	}
+
+	// ж,ĿԱؽʱ
+	void reset()
+	{
+		while (m_Finalizers != nullptr)
+		{
+			Finalizer *finalizer = m_Finalizers;
+			m_Finalizers = finalizer->m_Next;
+			finalizer->m_Destroy(finalizer->m_Object);
+		}
+
+		m_Current = nullptr;
+		m_Offset = 0;
+		m_Used = 0;
+	}
+
+	// ѷֽ()
+	// ΪСؽͬһ,һ뵽λ
+	size_t size() const
+	{
+		return m_Used;
+	}
+
+	// ƽĶǰռһ¼,ȼʱĴСͶۼ
+	static size_t finalizer_size()
+	{
+		return sizeof(Finalizer);
+	}
+
+	static size_t finalizer_align()
+	{
+		return alignof(Finalizer);
+	}
+
+	// ֽ
+	size_t capacity() const
+	{
+		size_t total = 0;
+		for (Block *block = m_First; block != nullptr; block = block->m_Next)
+		{
+			total += block->m_Size;
+		}
+		return total;
+	}
+
+protected:
+	struct Block
+	{
+		Block *m_Next;
+		size_t m_Size;
+	};
+
+	struct Finalizer
+	{
+		void(*m_Destroy)(void *);
+		void *m_Object;
+		Finalizer *m_Next;
+	};
+
+	template <typename T>
+	static void Destroy(void *object)
+	{
+		static_cast<T *>(object)->~T();
+	}
+
+	static size_t Align(size_t offset, size_t align)
+	{
+		return (offset + align - 1) & ~(align - 1);
+	}
+
+	// ַ,ڿڵƫ
+	static size_t AlignOffset(Block *block, size_t offset, size_t align)
+	{
+		uintptr_t base = (uintptr_t)Data(block);
+		return Align(base + offset, align) - base;
+	}
+
+	static uint8_t *Data(Block *block)
+	{
+		return reinterpret_cast<uint8_t *>(block) + Align(sizeof(Block), alignof(std::max_align_t));
+	}
+
+	void *Take(size_t offset, size_t size)
+	{
+		m_Used += offset - m_Offset + size;
+		m_Offset = offset + size;
+		return Data(m_Current) + offset;
+	}
+
+	// ¿,ڵǰ֮
+	Block *NewBlock(size_t size, Block *next)
+	{
+		return AddBlock(size > m_BlockSize ? size : m_BlockSize, next);
+	}
+
+	Block *AddBlock(size_t blockSize, Block *next)
+	{
+		assert(alignof(std::max_align_t) >= alignof(Block));
+		Block *block = static_cast<Block *>(::operator new(Align(sizeof(Block), alignof(std::max_align_t)) + blockSize));
+		block->m_Next = next;
+		block->m_Size = blockSize;
+
+		if (m_Current != nullptr)
+		{
+			m_Current->m_Next = block;
+		}
+		else
+		{
+			m_First = block;
+		}
+		return block;
+	}
+
+	size_t m_BlockSize;
+	Block *m_First;
+	Block *m_Current;
+	size_t m_Offset;
+	size_t m_Used;
+	Finalizer *m_Finalizers;
+};
+
+// ζ
+// ȡ2,ȡ±,Reserve֮ӳӶڴ
+template <class T>
+class CRingBuffer
+{
+public:
+	CRingBuffer() :
+		m_Buffer(nullptr),
+		m_Mask(0),
+		m_Head(0),
+		m_Size(0)
+	{
+	}
+
+	~CRingBuffer()
+	{
+		delete[] m_Buffer;
+	}
+
+	// ֤ܷcapacityԪ
+	void Reserve(size_t capacity)
+	{
+		if (capacity <= GetCapacity())
+		{
+			return;
+		}
+
+		size_t size = 1;
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+
+		T *buffer = new T[size];
+		for (size_t i = 0; i < m_Size; ++i)
+		{
+			buffer[i] = At(i);
+		}
+
+		delete[] m_Buffer;
+		m_Buffer = buffer;
+		m_Mask = size - 1;
+		m_Head = 0;
+	}
+
+	void PushFront(const T &value)
+	{
+		Grow();
+		m_Head = (m_Head - 1) & m_Mask;
+		m_Buffer[m_Head] = value;
+		++m_Size;
+	}
+
+	void PushBack(const T &value)
+	{
+		Grow();
+		m_Buffer[(m_Head + m_Size) & m_Mask] = value;
+		++m_Size;
+	}
+
+	T PopFront()
+	{
+		assert(m_Size > 0);
+		T value = m_Buffer[m_Head];
+		m_Head = (m_Head + 1) & m_Mask;
+		--m_Size;
+		return value;
+	}
+
+	T &At(size_t index)
+	{
+		assert(index < m_Size);
+		return m_Buffer[(m_Head + index) & m_Mask];
+	}
+
+	size_t GetSize() const
+	{
+		return m_Size;
+	}
+
+	size_t GetCapacity() const
+	{
+		return m_Buffer != nullptr ? m_Mask + 1 : 0;
+	}
+
+	bool IsEmpty() const
+	{
+		return m_Size == 0;
+	}
+
+	void Clear()
+	{
+		m_Head = 0;
+		m_Size = 0;
+	}
+
+protected:
+	// ӦPrepareʱڵͼȷ,ֻǶ
+	void Grow()
+	{
+		if (m_Size == GetCapacity())
+		{
+			Reserve(m_Size != 0 ? m_Size * 2 : 8);
+		}
+	}
+
+	T *m_Buffer;
+	size_t m_Mask;
+	size_t m_Head;
+	size_t m_Size;
+};
+
+// ڰ
+// ڽʱCBlackboardLayoutΪ̶ƫ,ֵһڴ
+// ȡֵֻǰƫƶд,·ûаֵĲ
+template <class T>
+struct SBlackboardKey
+{
+	SBlackboardKey() :
+		m_Index(0xFFFF),
+		m_Offset(0)
+	{
+	}
+
+	bool IsValid() const
+	{
+		return m_Index != 0xFFFF;
+	}
+
+	uint16_t m_Index;
+	uint32_t m_Offset;
+};
+
+// ڰ岼,
+// ֻڽʱ,֮޸
+class CBlackboardLayout
+{
+public:
+	CBlackboardLayout() :
+		m_Size(0)
+	{
+	}
+
+	// һ,ͬļظʱͬһ,ͱһ
+	template <class T>
+	SBlackboardKey<T> Declare(const char *name, const T &initial = T())
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "blackboard values must be trivially copyable");
+		static_assert(alignof(T) <= alignof(std::max_align_t), "blackboard value alignment too large");
+
+		SBlackboardKey<T> key;
+		auto it = m_Names.find(name);
+		if (it != m_Names.end())
+		{
+			const SEntry &entry = m_Entries[it->second];
+			assert(entry.m_Type == TypeTag<T>());
+			key.m_Index = it->second;
+			key.m_Offset = entry.m_Offset;
+			return key;
+		}
+
+		assert(m_Entries.size() < 0xFFFF);
+		SEntry entry;
+		entry.m_Offset = static_cast<uint32_t>(Align(m_Size, alignof(T)));
+		entry.m_Size = sizeof(T);
+		entry.m_Type = TypeTag<T>();
+		m_Size = entry.m_Offset + sizeof(T);
+		m_Defaults.resize(m_Size, 0);
+		memcpy(&m_Defaults[entry.m_Offset], &initial, sizeof(T));
+
+		key.m_Index = static_cast<uint16_t>(m_Entries.size());
+		key.m_Offset = entry.m_Offset;
+		m_Names[name] = key.m_Index;
+		m_Entries.push_back(entry);
+		return key;
+	}
+
+	// ֲļ,ûʱЧ
+	template <class T>
+	SBlackboardKey<T> Find(const char *name) const
+	{
+		SBlackboardKey<T> key;
+		auto it = m_Names.find(name);
+		if (it != m_Names.end() && m_Entries[it->second].m_Type == TypeTag<T>())
+		{
+			key.m_Index = it->second;
+			key.m_Offset = m_Entries[it->second].m_Offset;
+		}
+		return key;
+	}
+
+	size_t GetSize() const
+	{
+		return m_Size;
+	}
+
+	size_t GetKeyCount() const
+	{
+		return m_Entries.size();
+	}
+
+	const uint8_t *GetDefaults() const
+	{
+		return m_Defaults.empty() ? nullptr : &m_Defaults[0];
+	}
+
+	// ֵںڰеλúʹС
+	uint32_t GetKeyOffset(uint16_t key) const
+	{
+		return m_Entries[key].m_Offset;
+	}
+
+	uint32_t GetKeySize(uint16_t key) const
+	{
+		return m_Entries[key].m_Size;
+	}
+
+protected:
+	// ÿֵһַΪ,RTTI
+	template <class T>
+	static const void *TypeTag()
+	{
+		static const char tag = 0;
+		return &tag;
+	}
+
+	static size_t Align(size_t size, size_t align)
+	{
+		return (size + align - 1) & ~(align - 1);
+	}
+
+	struct SEntry
+	{
+		uint32_t m_Offset;
+		uint32_t m_Size;
+		const void *m_Type;
+	};
+
+	std::vector<SEntry> m_Entries;
+	std::unordered_map<std::string, uint16_t> m_Names;
+	std::vector<uint8_t> m_Defaults;
+	size_t m_Size;
+};
+
+class CBlackboard;
+
+// ڰı仯֪ͨ
+// ɹĳ,ںڰϸü,ڴ
+// ʱԶժ
+class CBlackboardWatch
+{
+public:
+	CBlackboardWatch() :
+		m_Blackboard(nullptr),
+		m_Prev(nullptr),
+		m_Next(nullptr),
+		m_Key(0),
+		m_Object(nullptr),
+		m_Function(nullptr)
+	{
+	}
+
+	~CBlackboardWatch()
+	{
+		Unwatch();
+	}
+
+	CBlackboardWatch(const CBlackboardWatch &) = delete;
+	CBlackboardWatch &operator=(const CBlackboardWatch &) = delete;
+
+	// 󶨳Ա,Ϊ仯ļ
+	template <class T, void (T::*METHOD)(uint16_t)>
+	void Bind(T *object)
+	{
+		m_Object = object;
+		m_Function = &Invoke<T, METHOD>;
+	}
+
+	bool IsWatching() const
+	{
+		return m_Blackboard != nullptr;
+	}
+
+	inline void Unwatch();
+
+protected:
+	friend class CBlackboard;
+
+	template <class T, void (T::*METHOD)(uint16_t)>
+	static void Invoke(void *object, uint16_t key)
+	{
+		(static_cast<T *>(object)->*METHOD)(key);
+	}
+
+	CBlackboard *m_Blackboard;
+	CBlackboardWatch *m_Prev;
+	CBlackboardWatch *m_Next;
+	uint16_t m_Key;
+	void *m_Object;
+	void(*m_Function)(void *, uint16_t);
+};
+
+// ĺڰ
+// ֵ,ÿİ汾ź֪ͨͷͬһڴ
+class CBlackboard
+{
+public:
+	CBlackboard() :
+		m_Layout(nullptr),
+		m_Data(nullptr),
+		m_Versions(nullptr),
+		m_Watches(nullptr),
+		m_Notify(nullptr)
+	{
+	}
+
+	~CBlackboard()
+	{
+		Release();
+	}
+
+	CBlackboard(const CBlackboard &) = delete;
+	CBlackboard &operator=(const CBlackboard &) = delete;
+
+	// ַڴ沢ʼֵ,֮¼
+	void Reset(const CBlackboardLayout &layout)
+	{
+		Release();
+
+		size_t count = layout.GetKeyCount();
+		size_t watches = Align(layout.GetSize(), alignof(CBlackboardWatch *));
+		size_t versions = watches + count * sizeof(CBlackboardWatch *);
+		uint8_t *block = static_cast<uint8_t *>(::operator new(versions + count * sizeof(uint32_t)));
+
+		m_Layout = &layout;
+		m_Data = block;
+		m_Watches = reinterpret_cast<CBlackboardWatch **>(block + watches);
+		m_Versions = reinterpret_cast<uint32_t *>(block + versions);
+		if (layout.GetSize() != 0)
+		{
+			memcpy(m_Data, layout.GetDefaults(), layout.GetSize());
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			m_Watches[i] = nullptr;
+			m_Versions[i] = 0;
+		}
+	}
+
+	const CBlackboardLayout *GetLayout() const
+	{
+		return m_Layout;
+	}
+
+	template <class T>
+	const T &Get(SBlackboardKey<T> key) const
+	{
+		assert(key.m_Index < m_Layout->GetKeyCount());
+		return *reinterpret_cast<const T *>(m_Data + key.m_Offset);
+	}
+
+	// ֵıʱ汾żһ,֪ͨĸü
+	template <class T>
+	void Set(SBlackboardKey<T> key, const T &value)
+	{
+		assert(key.m_Index < m_Layout->GetKeyCount());
+		uint8_t *slot = m_Data + key.m_Offset;
+		if (memcmp(slot, &value, sizeof(T)) == 0)
+		{
+			return;
+		}
+
+		memcpy(slot, &value, sizeof(T));
+		Changed(key.m_Index);
+	}
+
+	// : ԭмֵ,汾ź֪ͨ
+	void Save(CSnapshotWriter &writer) const
+	{
+		writer.Write(static_cast<uint32_t>(m_Layout->GetKeyCount()));
+		writer.Write(static_cast<uint32_t>(m_Layout->GetSize()));
+		writer.WriteBytes(m_Data, m_Layout->GetSize());
+	}
+
+	// Saveֵд,ֲͬʱnullptr
+	const uint8_t *Read(CSnapshotReader &reader) const
+	{
+		if (m_Layout == nullptr || reader.Read() != m_Layout->GetKeyCount() || reader.Read() != m_Layout->GetSize())
+		{
+			return nullptr;
+		}
+		return reader.ReadBytes(m_Layout->GetSize());
+	}
+
+	// дReadֵ,뵱ǰֵͬļSetһӰ汾֪ͨ
+	void Restore(const uint8_t *data)
+	{
+		for (uint16_t key = 0; key < m_Layout->GetKeyCount(); ++key)
+		{
+			uint32_t offset = m_Layout->GetKeyOffset(key);
+			uint32_t size = m_Layout->GetKeySize(key);
+			if (memcmp(m_Data + offset, data + offset, size) != 0)
+			{
+				memcpy(m_Data + offset, data + offset, size);
+				Changed(key);
+			}
+		}
+	}
+
+	// İ汾,ÿθıһ,жϴζȡǷ
+	uint32_t GetVersion(uint16_t key) const
+	{
+		assert(key < m_Layout->GetKeyCount());
+		return m_Versions[key];
+	}
+
+	void Watch(CBlackboardWatch &watch, uint16_t key)
+	{
+		assert(key < m_Layout->GetKeyCount());
+		assert(watch.m_Function != nullptr);
+		watch.Unwatch();
+
+		watch.m_Blackboard = this;
+		watch.m_Key = key;
+		watch.m_Prev = nullptr;
+		watch.m_Next = m_Watches[key];
+		if (m_Watches[key] != nullptr)
+		{
+			m_Watches[key]->m_Prev = &watch;
+		}
+		m_Watches[key] = &watch;
+	}
+
+	void Unwatch(CBlackboardWatch &watch)
+	{
+		assert(watch.m_Blackboard == this);
+
+		// ֪ͨժǡһҪ֪ͨ,
+		for (SNotify *notify = m_Notify; notify != nullptr; notify = notify->m_Outer)
+		{
+			if (notify->m_Next == &watch)
+			{
+				notify->m_Next = watch.m_Next;
+			}
+		}
+
+		if (watch.m_Prev != nullptr)
+		{
+			watch.m_Prev->m_Next = watch.m_Next;
+		}
+		else
+		{
+			m_Watches[watch.m_Key] = watch.m_Next;
+		}
+		if (watch.m_Next != nullptr)
+		{
+			watch.m_Next->m_Prev = watch.m_Prev;
+		}
+
+		watch.m_Blackboard = nullptr;
+		watch.m_Prev = nullptr;
+		watch.m_Next = nullptr;
+	}
+
+protected:
+	// ֪ͨлصժ֪ͨ,Ҳٴдڰ
+	// ÿ֪ͨջϼ¼һҪ֪ͨĶ,ժʱһ
+	struct SNotify
+	{
+		CBlackboardWatch *m_Next;
+		SNotify *m_Outer;
+	};
+
+	void Changed(uint16_t key)
+	{
+		++m_Versions[key];
+
+		SNotify notify = { m_Watches[key], m_Notify };
+		m_Notify = &notify;
+		while (notify.m_Next != nullptr)
+		{
+			CBlackboardWatch *watch = notify.m_Next;
+			notify.m_Next = watch->m_Next;
+			watch->m_Function(watch->m_Object, key);
+		}
+		m_Notify = notify.m_Outer;
+	}
+
+	void Release()
+	{
+		if (m_Data == nullptr)
+		{
+			return;
+		}
+
+		for (size_t i = 0; i < m_Layout->GetKeyCount(); ++i)
+		{
+			while (m_Watches[i] != nullptr)
+			{
+				Unwatch(*m_Watches[i]);
+			}
+		}
+
+		::operator delete(m_Data);
+		m_Layout = nullptr;
+		m_Data = nullptr;
+		m_Watches = nullptr;
+		m_Versions = nullptr;
+	}
+
+	static size_t Align(size_t size, size_t align)
+	{
+		return (size + align - 1) & ~(align - 1);
+	}
+
+	const CBlackboardLayout *m_Layout;
+	uint8_t *m_Data;
+	uint32_t *m_Versions;
+	CBlackboardWatch **m_Watches;
+	SNotify *m_Notify;
+};
+
+void CBlackboardWatch::Unwatch()
+{
+	if (m_Blackboard != nullptr)
+	{
+		m_Blackboard->Unwatch(*this);
+	}
+}
+
+// 汾֮ͼһ,һı䶼ʹ仯,0ûм¼
+inline uint32_t StampDependencies(const CBlackboard &blackboard, const SDependencies &dependencies)
+{
+	uint32_t stamp = 1;
+	for (uint16_t i = 0; i < dependencies.m_Count; ++i)
+	{
+		stamp += blackboard.GetVersion(dependencies.m_Keys[i]);
+	}
+	return stamp;
+}
+
+// ʱ,ɵȴ,ڴĶʱ,ڴ
+// ʱָΪ,ʱԶȡ
+class CTimerWheel;
+class CTimer
+{
+public:
+	CTimer() :
+		m_Wheel(nullptr),
+		m_Prev(nullptr),
+		m_Next(nullptr),
+		m_Deadline(0),
+		m_Behavior(nullptr)
+	{
+	}
+
+	~CTimer()
+	{
+		Cancel();
+	}
+
+	CTimer(const CTimer &) = delete;
+	CTimer &operator=(const CTimer &) = delete;
+
+	// ûе
+	bool IsPending() const
+	{
+		return m_Wheel != nullptr;
+	}
+
+	inline void Cancel();
+
+	// ൽڻм֡,ֻڵȴʱ
+	inline uint32_t GetRemaining() const;
+
+protected:
+	friend class CTimerWheel;
+
+	CTimerWheel *m_Wheel;
+	CTimer *m_Prev;
+	CTimer *m_Next;
+	uint64_t m_Deadline;
+	CBehavior *m_Behavior;
+};
+
+// ʱ
+// ʱ֡k_TimerSlots,ǰʱֻ龭Ĳ,һȦԺ
+// ¼ĵ֡,ûеڵĶʱʱǰֻǼһʱ
+const size_t k_TimerSlots = 16;
+class CTimerWheel
+{
+public:
+	CTimerWheel() :
+		m_Now(0),
+		m_Earliest(std::numeric_limits<uint64_t>::max()),
+		m_Count(0)
+	{
+		for (size_t i = 0; i < k_TimerSlots; ++i)
+		{
+			m_Slots[i] = nullptr;
+		}
+	}
+
+	~CTimerWheel()
+	{
+		for (size_t i = 0; i < k_TimerSlots; ++i)
+		{
+			while (m_Slots[i] != nullptr)
+			{
+				Cancel(*m_Slots[i]);
+			}
+		}
+	}
+
+	CTimerWheel(const CTimerWheel &) = delete;
+	CTimerWheel &operator=(const CTimerWheel &) = delete;
+
+	// frames֡,ʱָbehavior
+	void Add(CTimer &timer, uint32_t frames, CBehavior *behavior)
+	{
+		Cancel(timer);
+
+		timer.m_Wheel = this;
+		timer.m_Deadline = m_Now + (frames != 0 ? frames : 1);
+		timer.m_Behavior = behavior;
+
+		CTimer *&slot = m_Slots[timer.m_Deadline & (k_TimerSlots - 1)];
+		timer.m_Prev = nullptr;
+		timer.m_Next = slot;
+		if (slot != nullptr)
+		{
+			slot->m_Prev = &timer;
+		}
+		slot = &timer;
+		++m_Count;
+
+		if (timer.m_Deadline < m_Earliest)
+		{
+			m_Earliest = timer.m_Deadline;
+		}
+	}
+
+	void Cancel(CTimer &timer)
+	{
+		if (timer.m_Wheel == nullptr)
+		{
+			return;
+		}
+
+		assert(timer.m_Wheel == this);
+		if (timer.m_Prev != nullptr)
+		{
+			timer.m_Prev->m_Next = timer.m_Next;
+		}
+		else
+		{
+			m_Slots[timer.m_Deadline & (k_TimerSlots - 1)] = timer.m_Next;
+		}
+		if (timer.m_Next != nullptr)
+		{
+			timer.m_Next->m_Prev = timer.m_Prev;
+		}
+
+		timer.m_Wheel = nullptr;
+		timer.m_Prev = nullptr;
+		timer.m_Next = nullptr;
+		--m_Count;
+	}
+
+	// ǰframes֡,ԵڵĶʱfire(behavior),Ƿжʱ
+	// һȦʱÿֻһ
+	template <class FIRE>
+	bool Advance(uint32_t frames, FIRE fire)
+	{
+		uint64_t now = m_Now + frames;
+		if (now < m_Earliest)
+		{
+			m_Now = now;
+			return false;
+		}
+
+		size_t slots = frames < k_TimerSlots ? frames : k_TimerSlots;
+		for (size_t k = 1; k <= slots && m_Count != 0; ++k)
+		{
+			CTimer *timer = m_Slots[(m_Now + k) & (k_TimerSlots - 1)];
+			while (timer != nullptr)
+			{
+				CTimer *next = timer->m_Next;
+				if (timer->m_Deadline <= now)
+				{
+					CBehavior *behavior = timer->m_Behavior;
+					Cancel(*timer);
+					fire(behavior);
+				}
+				timer = next;
+			}
+		}
+		m_Now = now;
+
+		// ȡĶʱm_Earliest,ͳʣµ
+		m_Earliest = std::numeric_limits<uint64_t>::max();
+		for (size_t i = 0; i < k_TimerSlots && m_Count != 0; ++i)
+		{
+			for (CTimer *timer = m_Slots[i]; timer != nullptr; timer = timer->m_Next)
+			{
+				m_Earliest = timer->m_Deadline < m_Earliest ? timer->m_Deadline : m_Earliest;
+			}
+		}
+		return true;
+	}
+
+	uint64_t GetNow() const
+	{
+		return m_Now;
+	}
+
+	// ȴеĶʱ
+	size_t GetCount() const
+	{
+		return m_Count;
+	}
+
+protected:
+	CTimer *m_Slots[k_TimerSlots];
+	uint64_t m_Now;
+	uint64_t m_Earliest;
+	size_t m_Count;
+};
+
+void CTimer::Cancel()
+{
+	if (m_Wheel != nullptr)
+	{
+		m_Wheel->Cancel(*this);
+	}
+}
+
+uint32_t CTimer::GetRemaining() const
+{
+	assert(m_Wheel != nullptr);
+	return static_cast<uint32_t>(m_Deadline - m_Wheel->GetNow());
+}
+
+// TickĹ,Ϊ0
+struct STickBudget
+{
+	STickBudget(uint32_t maxSteps = 0, uint32_t maxMicroseconds = 0) :
+		m_MaxSteps(maxSteps),
+		m_MaxMicroseconds(maxMicroseconds)
+	{
+	}
+
+	bool IsLimited() const
+	{
+		return m_MaxSteps != 0 || m_MaxMicroseconds != 0;
+	}
+
+	uint32_t m_MaxSteps;
+	uint32_t m_MaxMicroseconds;
+};
+
+// Tickͳ
+struct SBudgetStats
+{
+	// ִ֡
+	uint64_t m_Frames;
+	// Ԥ;صĴ
+	uint64_t m_Exhausted;
+	// ִеΪ
+	uint64_t m_Steps;
+};
+
+class CBatchScheduler;
+
+class CBehaviorTree
+{
+public:
+	CBehaviorTree() :
+		m_Batcher(nullptr),
+		m_AgentIndex(0),
+		m_BatchPending(false),
+		m_Current(nullptr),
+		m_Interrupted(false),
+		m_ElapsedFrames(1)
+	{
+		ResetBudgetStats();
+	}
+
+	// ڵͼΪԤڴ͵ȶ,ڵͼᱻ޸
+	void Prepare(const CNode &root)
+	{
+		STaskDemand demand;
+		root.Measure(demand);
+		m_TaskPool.Reserve(demand);
+
+		// ͬʱŶӵΪڴ,ÿ֡Ľ
+		size_t behaviors = 1;
+		for (size_t i = 0; i < demand.m_Counts.size(); ++i)
+		{
+			behaviors += demand.m_Counts[i];
+		}
+		m_Behaviors.Reserve(m_Behaviors.GetSize() + behaviors);
+	}
+
+	CTaskPool &GetTaskPool()
+	{
+		return m_TaskPool;
+	}
+
+	// ĺڰ,ʹ߰Reset
+	CBlackboard &GetBlackboard()
+	{
+		return m_Blackboard;
+	}
+
+	void Start(CBehavior &n, BehaviorObserver *observer = nullptr)
+	{
+		if (observer != nullptr)
+		{
+			n.m_Observer = *observer;
+		}
+
+		// ¼Ͻڵֻӽڵ,ȶֻеҶ
+		n.m_Status = BH_RUNNING;
+		if (n.m_Task->OnStart(n))
+		{
+			n.m_Task->SetEventDriven(true);
+			return;
+		}
+
+		n.m_Status = BH_INVALID;
+		m_Behaviors.PushFront(&n);
+	}
+
+	void Stop(CBehavior &n, eStatus result)
+	{
+		assert(result != BH_RUNNING);
+		n.m_Status = result;
+
+		if (n.m_Observer)
+		{
+			n.m_Observer(result);
+		}
+	}
+
+	// Ϊڵȶ,ResumeڵĶʱŻضβ
+	// bǵȶִʱBH_SUSPENDEDΪ,¼ʱҶӱ,ѯʱΪ
+	void Resume(CBehavior &b)
+	{
+		if (b.m_Status != BH_SUSPENDED)
+		{
+			return;
+		}
+
+		b.m_Status = BH_RUNNING;
+		m_Behaviors.PushBack(&b);
+	}
+
+	// Start,LoadSnapshotָѯ,bSetupҲڶ
+	// лûʼķŻضβ,ɻָĶʱ,ѽĲִ
+	void Restore(CBehavior &b, BehaviorObserver *observer = nullptr)
+	{
+		if (observer != nullptr)
+		{
+			b.m_Observer = *observer;
+		}
+
+		if (b.m_Status == BH_RUNNING || b.m_Status == BH_INVALID)
+		{
+			m_Behaviors.PushBack(&b);
+		}
+	}
+
+	// Updateе,framesָ֡ǰִеΪ,֮񷵻BH_SUSPENDED
+	// ʱڵһSleepʱŴ,öʱĴռⲿڴ
+	void Sleep(CTimer &timer, uint32_t frames)
+	{
+		Sleep(timer, frames, m_Current);
+	}
+
+	// ָʱָΪ,ָʱ
+	void Sleep(CTimer &timer, uint32_t frames, CBehavior *behavior)
+	{
+		if (m_Timers == nullptr)
+		{
+			m_Timers.reset(new CTimerWheel());
+		}
+		m_Timers->Add(timer, frames, behavior);
+	}
+
+	// StepִеΪ,ȴ¼,¼ʱResume
+	CBehavior *GetCurrent() const
+	{
+		return m_Current;
+	}
+
+	// ȴеĶʱ
+	size_t GetTimerCount() const
+	{
+		return m_Timers != nullptr ? m_Timers->GetCount() : 0;
+	}
+
+	// ,ҶӰŶȡ
+	uint32_t GetAgentIndex() const
+	{
+		return m_AgentIndex;
+	}
+
+	void SetAgentIndex(uint32_t index)
+	{
+		m_AgentIndex = index;
+	}
+
+	// ú,ȶеҶӽbatcherһֵ
+	void SetBatcher(CBatchScheduler *batcher)
+	{
+		m_Batcher = batcher;
+	}
+
+	// һ֡Ԥʱ,Ȱһ֡ʣµΪִ
+	void Tick()
+	{
+		if (!m_Interrupted && !BeginFrame())
+		{
+			return;
+		}
+		m_Interrupted = false;
+
+		while (Step())
+		{
+			continue;
+		}
+	}
+
+	// ִ,trueʾִ֡
+	// Ԥʱڶ,´δжϴ,ִ֡еΪڱ֮,δִеٴִ
+	// ʱÿk_BudgetClockStepsһ,ÿεִһ
+	bool Tick(const STickBudget &budget)
+	{
+		static const uint32_t k_BudgetClockSteps = 8;
+
+		if (!m_Interrupted && !BeginFrame())
+		{
+			++m_BudgetStats.m_Frames;
+			return true;
+		}
+
+		std::chrono::steady_clock::time_point deadline;
+		if (budget.m_MaxMicroseconds != 0)
+		{
+			deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(budget.m_MaxMicroseconds);
+		}
+
+		for (uint32_t steps = 0; ; ++steps)
+		{
+			if (steps != 0 && m_Behaviors.At(0) != nullptr &&
+				((budget.m_MaxSteps != 0 && steps == budget.m_MaxSteps) ||
+				(budget.m_MaxMicroseconds != 0 && steps % k_BudgetClockSteps == 0 && std::chrono::steady_clock::now() >= deadline)))
+			{
+				m_Interrupted = true;
+				++m_BudgetStats.m_Exhausted;
+				return false;
+			}
+
+			if (!Step())
+			{
+				m_Interrupted = false;
+				++m_BudgetStats.m_Frames;
+				return true;
+			}
+			++m_BudgetStats.m_Steps;
+		}
+	}
+
+	// һ֡ǷԤ,ûִ
+	bool IsInterrupted() const
+	{
+		return m_Interrupted;
+	}
+
+	// ϴTick֡,ɷּ,ʱݴ˻
+	uint32_t GetElapsedFrames() const
+	{
+		return m_ElapsedFrames;
+	}
+
+	void SetElapsedFrames(uint32_t frames)
+	{
+		m_ElapsedFrames = frames;
+	}
+
+	const SBudgetStats &GetBudgetStats() const
+	{
+		return m_BudgetStats;
+	}
+
+	void ResetBudgetStats()
+	{
+		m_BudgetStats.m_Frames = 0;
+		m_BudgetStats.m_Exhausted = 0;
+		m_BudgetStats.m_Steps = 0;
+	}
+
+	// ȶеΪ
+	size_t GetScheduledCount() const
+	{
+		return m_Behaviors.GetSize();
+	}
+
+	bool Step()
+	{
+		CBehavior *current = m_Behaviors.PopFront();
+
+		if (current == nullptr)
+		{
+			return false;
+		}
+
+		if (current->m_Task->IsBatched() && m_Batcher != nullptr)
+		{
+			Defer(*current);
+			return true;
+		}
+
+		m_Current = current;
+		current->Tick();
+		m_Current = nullptr;
+
+		Finish(*current);
+		return true;
+	}
+
+protected: 
+	friend class CBatchScheduler;
+
+	// ִк״̬֪ͨ۲߻Żض
+	void Finish(CBehavior &b)
+	{
+		// Ϊ뿪,֮ÿ֡ûκο
+		if (b.m_Status == BH_SUSPENDED)
+		{
+			return;
+		}
+
+		if (b.m_Status != BH_RUNNING && b.m_Observer)
+		{
+			b.m_Observer(b.m_Status);
+		}
+		else
+		{
+			m_Behaviors.PushBack(&b);
+		}
+	}
+
+	// ,CBatchScheduler֮
+	void Defer(CBehavior &b);
+
+	// ʱǰ,ڵΪŻض,֡ͻִ
+	// ȫʱfalse,ִ֡
+	bool BeginFrame()
+	{
+		if (m_Timers != nullptr)
+		{
+			m_Timers->Advance(m_ElapsedFrames, [this](CBehavior *behavior)
+			{
+				if (behavior != nullptr)
+				{
+					Resume(*behavior);
+				}
+			});
+		}
+
+		if (m_Behaviors.IsEmpty())
+		{
+			return false;
+		}
+		m_Behaviors.PushBack(nullptr);
+		return true;
+	}
+
+	CRingBuffer<CBehavior *> m_Behaviors;
+	CTaskPool m_TaskPool;
+	// ֮,ʱ,ȡϲĶʱ
+	std::unique_ptr<CTimerWheel> m_Timers;
+	CBatchScheduler *m_Batcher;
+	uint32_t m_AgentIndex;
+	bool m_BatchPending;
+	CBehavior *m_Current;
+	bool m_Interrupted;
+	uint32_t m_ElapsedFrames;
+	SBudgetStats m_BudgetStats;
+	// ֮,ʱ,ժϲ֪ͨ
+	CBlackboard m_Blackboard;
+};
+
+// ոʽİ汾,񱣴ݸıʱ
+const uint32_t k_SnapshotVersion = 1;
+
+// ձͻָΪ״̬,ڷǨ,浵ͻع
+// ʽ: 汾 | Ƿڰ | [ڰֵ] | Ϊ״̬
+// ֻ֧ѯִеĸ: ֱӵCBehavior::TickΪ,򽻸CBehaviorTreeȵOnStartfalseĸ
+// ¼ĸ(StartʱOnStarttrue)еȶк͹۲е״̬,ڿ,ͻָfalse
+// ΪдҴкڰʱһڰֵ
+bool SaveSnapshot(const CBehavior &behavior, std::vector<uint8_t> &buffer)
+{
+	buffer.clear();
+	if (behavior.m_Task == nullptr || behavior.m_Task->IsEventDriven())
+	{
+		return false;
+	}
+
+	CSnapshotWriter writer(buffer);
+	writer.Write(k_SnapshotVersion);
+
+	CBehaviorTree *bt = behavior.m_Task->GetBehaviorTree();
+	if (bt != nullptr && bt->GetBlackboard().GetLayout() != nullptr)
+	{
+		writer.Write(1);
+		bt->GetBlackboard().Save(writer);
+	}
+	else
+	{
+		writer.Write(0);
+	}
+
+	behavior.Save(writer);
+	return true;
+}
+
+// ͬĽڵͼϻָ,ԭᱻ´
+// ʧʱΪصʼ״̬,´Tickͷʼ,ڰ岻;ΪûSetup¼ĸʱfalse
+// ɴȵĸָCBehaviorTree::RestoreŻض,ڻָʱ¹϶ʱ
+bool LoadSnapshot(CBehavior &behavior, const uint8_t *data, size_t size)
+{
+	if (behavior.m_Task == nullptr || behavior.m_Task->IsEventDriven())
+	{
+		return false;
+	}
+
+	if (behavior.IsActive())
+	{
+		behavior.Abort();
+	}
+	behavior.Rest();
+	CBehaviorTree *bt = behavior.m_Task->GetBehaviorTree();
+	behavior.Setup(*behavior.m_Node, bt);
+
+	// ڰն겢ͨд
+	CSnapshotReader reader(data, size, &behavior);
+	const uint8_t *values = nullptr;
+	bool ok = reader.Read() == k_SnapshotVersion;
+	if (ok && reader.Read(2) == 1)
+	{
+		values = bt != nullptr ? bt->GetBlackboard().Read(reader) : nullptr;
+		ok = values != nullptr;
+	}
+
+	if (ok && !reader.IsFailed() && behavior.Load(reader) && reader.IsEnd())
+	{
+		if (values != nullptr)
+		{
+			bt->GetBlackboard().Restore(values);
+		}
+		return true;
+	}
+
+	if (behavior.IsActive())
+	{
+		behavior.Abort();
+	}
+	behavior.Rest();
+	behavior.Setup(*behavior.m_Node, bt);
+	return false;
+}
+
+// Ϊbt,ûдʱֱڶϴ
+template <class TASK, class NODE>
+TASK *CreateTask(NODE &node, CBehaviorTree *bt)
+{
+	TASK *task = bt != nullptr ? bt->GetTaskPool().Create<TASK>(node) : new TASK(node);
+	task->SetBehaviorTree(bt);
+	task->SetType(CTaskType::Index<TASK>());
+	return task;
+}
+
+template <class TASK>
+void DestroyTask(CTask *task)
+{
+	CBehaviorTree *bt = task->GetBehaviorTree();
+	if (bt != nullptr)
+	{
+		bt->GetTaskPool().Destroy<TASK>(task);
+		return;
+	}
+	delete task;
+}
+
+// Ϊ񴴽countT,ȡ,ûдʱڶ
+template <class T>
+T *CreateTaskArray(CBehaviorTree *bt, size_t count)
+{
+	size_t size = sizeof(T) * count;
+	void *p = bt != nullptr ? bt->GetTaskPool().AllocateArray(size) : ::operator new(size);
+	T *array = static_cast<T *>(p);
+	for (size_t i = 0; i < count; ++i)
+	{
+		new (array + i) T();
+	}
+	return array;
+}
+
+template <class T>
+void DestroyTaskArray(CBehaviorTree *bt, T *array, size_t count)
+{
+	for (size_t i = count; i > 0; --i)
+	{
+		array[i - 1].~T();
+	}
+
+	if (bt != nullptr)
+	{
+		bt->GetTaskPool().FreeArray(array, sizeof(T) * count);
+		return;
+	}
+	::operator delete(array);
+}
+
+// Ϊ
+struct CMockTask :public CTask
+{
+	int m_InitializeCalled;
+	int m_TerminateCalled;
+	int m_UpdateCalled;
+	eStatus m_ReturnStatus;
+	eStatus m_TerminateStatus;
+
+	CMockTask(CNode &node) :
+		CTask(node),
+		m_InitializeCalled(0),
+		m_TerminateCalled(0),
+		m_UpdateCalled(0),
+		m_ReturnStatus(BH_RUNNING),
+		m_TerminateStatus(BH_INVALID)
+	{
+	}
+
+	typedef CMockTask Self;
+	typedef CTask Base;
+
+	virtual void OnInitialize()
+	{
+		++m_InitializeCalled;
+	}
+
+	virtual void OnTerminate(eStatus s)
+	{
+		++m_TerminateCalled;
+		m_TerminateStatus = s;
+	}
+
+	virtual eStatus Update()
+	{
+		++m_UpdateCalled;
+		return m_ReturnStatus;
+	}
+};
+
+// ڵ㹤
+struct CMockNode :public CNode
+{
+	virtual CTask *Create(CBehaviorTree *bt)
+	{
+		return CreateTask<CMockTask>(*this, bt);
+	}
+
+	virtual void Destroy(CTask *task)
+	{
+		DestroyTask<CMockTask>(task);
+	}
+
+	virtual void Measure(STaskDemand &demand) const
+	{
+		demand.Add<CMockTask>();
+	}
+};
+
+void test()
+{
+	CBehaviorAllocate t;
+	CMockNode &n = t.allocate<CMockNode>();
+	CBehavior &b = t.allocate<CBehavior>();
+	b.Setup(n);
+
+	CBehaviorTree bt;
+	bt.Start(b);
+	bt.Tick();
+}
+
+// װνڵ㣬ֻһڵ
+class CDecorator :public CNode
+{
+public:
+	CDecorator(CNode *child) :m_Child(child) {}
+	CNode & GetChild() { return *m_Child; }
+	const CNode & GetChild() const { return *m_Child; }
+
+	virtual void Measure(STaskDemand &demand) const
+	{
+		m_Child->Measure(demand);
+	}
+
+protected:
+	CNode * m_Child;
+};
+
+// װνڵ㹤
+template <class TASK>
+class CMockDecorator :public CDecorator
+{
+public:
+	CMockDecorator(CNode *child) :
+		CDecorator(child)
+	{
+
+	}
+
+	virtual CTask *Create(CBehaviorTree *bt)
+	{
+		return CreateTask<TASK>(*this, bt);
+	}
+
+	virtual void Destroy(CTask *task)
+	{
+		DestroyTask<TASK>(task);
+	}
+
+	virtual void Measure(STaskDemand &demand) const
+	{
+		CDecorator::Measure(demand);
+		demand.Add<TASK>();
+	}
+
+	virtual eNodeKind GetKind() const
+	{
+		return TASK::k_Kind;
+	}
+};
+
+// ظ
+class CRepeat :public CTask
+{
+public:
+	// ظĬȡڵ
+	CRepeat(CDecorator &node) :
+		CTask(node),
+		m_Limit(static_cast<int>(node.GetParam()))
+	{
+	}
+
+	static const eNodeKind k_Kind = NODE_REPEAT;
+	typedef CRepeat Self;
+	typedef CTask Base;
+
+	CDecorator &GetNode()
+	{
+		return *static_cast<CDecorator*>(m_Node);
+	}
+
+	void SetCount(int count)
+	{
+		m_Limit = count;
+	}
+
+	virtual void OnInitialize()
+	{
+		m_Counter = 0;
+		m_Behavior.Setup(GetNode().GetChild(), m_BehaviorTree);
+	}
+
+	// ӽڵлʱӽڵ,ԭ
+	virtual eStatus Update()
+	{
+		for (;;)
+		{
+			m_Behavior.Tick();
+			if (m_Behavior.IsActive()) return m_Behavior.GetStatus();
+			if (m_Behavior.GetStatus() == BH_FAILURE) return BH_FAILURE;
+			if (++m_Counter == m_Limit) return BH_SUCCESS;
+			m_Behavior.Rest();
+		}
+	}
+
+	virtual void Save(CSnapshotWriter &writer) const
+	{
+		writer.Write(static_cast<uint32_t>(m_Limit));
+		writer.Write(static_cast<uint32_t>(m_Counter));
+		m_Behavior.Save(writer);
+	}
+
+	// ڵͬ,ɵĴСڴ
+	virtual bool Load(CSnapshotReader &reader)
+	{
+		uint32_t limit = reader.Read();
+		uint32_t counter = reader.Read(limit);
+		if (reader.IsFailed() || limit != GetNode().GetParam() || limit > static_cast<uint32_t>(std::numeric_limits<int>::max()))
+		{
+			return false;
+		}
+
+		m_Limit = static_cast<int>(limit);
+		m_Counter = static_cast<int>(counter);
+		m_Behavior.Setup(GetNode().GetChild(), m_BehaviorTree);
+		return m_Behavior.Load(reader);
+	}
+
+protected:
+	int m_Limit;
+	int m_Counter;
+	CBehavior m_Behavior;
+};
+
+typedef CMockDecorator<CRepeat> CMockRepeat;
+
+void testrepeat()
+{
+	CBehaviorTree bt;
+	CBehaviorAllocate t;
+	CMockNode &n = t.allocate<CMockNode>();
+	CMockRepeat re(&n);
+	CBehavior b(re, &bt);
+	b.Get<CRepeat>()->SetCount(3);
+	b.Tick();
+}
+
+const size_t k_MaxChildrenPerComposite = 7;
+// Ͻڵ㣬ӵжӽڵ
+// ӽڵ㱣Ϊthisƫ,һm_Children
+// ӽڵ㳬k_MaxChildrenPerComposite,ƫƳuint16_tʱ,
+// Ϊڷһint32_tƫ(ͬthis),
+class CComposite :public CNode
+{
+public:
+	CComposite() :
+		m_ChildCount(0),
+		m_Capacity(0),
+		m_Span(0),
+		m_Allocate(nullptr)
+	{
+	}
+
+	// ָⲿʹõķ,Ԥcapacityӽڵ
+	void Reserve(CBehaviorAllocate &allocate, size_t capacity)
+	{
+		m_Allocate = &allocate;
+		if (capacity > k_MaxChildrenPerComposite && capacity > m_Capacity)
+		{
+			Spill(capacity);
+		}
+	}
+
+	void AddChild(CNode &child)
+	{
+		ptrdiff_t p = MakeRoom(child);
+		if (IsSpilled())
+		{
+			GetSpan()[m_ChildCount++] = static_cast<int32_t>(p);
+		}
+		else
+		{
+			m_Children[m_ChildCount++] = static_cast<uint16_t>(p);
+		}
+	}
+
+	void AddChildFront(CNode &child)
+	{
+		ptrdiff_t p = MakeRoom(child);
+		if (IsSpilled())
+		{
+			int32_t *span = GetSpan();
+			for (uint16_t i = m_ChildCount; i > 0; --i)
+			{
+				span[i] = span[i - 1];
+			}
+			span[0] = static_cast<int32_t>(p);
+		}
+		else
+		{
+			for (uint16_t i = m_ChildCount; i > 0; --i)
+			{
+				m_Children[i] = m_Children[i - 1];
+			}
+			m_Children[0] = static_cast<uint16_t>(p);
+		}
+		++m_ChildCount;
+	}
+
+	CNode &GetChild(uint16_t index)
+	{
+		assert(index < m_ChildCount);
+		if (IsSpilled())
+		{
+			return *(CNode*)((intptr_t)this + GetSpan()[index]);
+		}
+		return *(CNode*)((uintptr_t)this + m_Children[index]);
+	}
+
+	const CNode &GetChild(uint16_t index) const
+	{
+		return const_cast<CComposite *>(this)->GetChild(index);
+	}
+
+	uint16_t GetChildCount() const
+	{
+		return m_ChildCount;
+	}
+
+	bool IsSpilled() const
+	{
+		return m_Capacity != 0;
+	}
+
+	// ͬһʱֻһӽڵ,ȡӽڵֵ
+	virtual void Measure(STaskDemand &demand) const
+	{
+		STaskDemand children;
+		for (uint16_t i = 0; i < m_ChildCount; ++i)
+		{
+			STaskDemand child;
+			GetChild(i).Measure(child);
+			children.Max(child);
+		}
+		demand.Sum(children);
+	}
+
+protected:
+	int32_t *GetSpan() const
+	{
+		return (int32_t *)((intptr_t)this + m_Span);
+	}
+
+	// childƫ,Ųʱת浽ⲿ
+	ptrdiff_t MakeRoom(CNode &child)
+	{
+		assert(m_ChildCount < std::numeric_limits<uint16_t>::max());
+		ptrdiff_t p = (intptr_t)&child - (intptr_t)this;
+		assert(p > std::numeric_limits<int32_t>::min() && p < std::numeric_limits<int32_t>::max());
+
+		if (IsSpilled())
+		{
+			if (m_ChildCount == m_Capacity)
+			{
+				Spill(m_Capacity * 2);
+			}
+		}
+		else if (m_ChildCount == k_MaxChildrenPerComposite || p <= 0 || p >= std::numeric_limits<uint16_t>::max())
+		{
+			Spill(k_MaxChildrenPerComposite * 2);
+		}
+		return p;
+	}
+
+	// ڷµƫ,ڷһͷ
+	void Spill(size_t capacity)
+	{
+		// ûеReserveͳ,ⲿ޴,дԽ,κι¶ֱֹ
+		if (m_Allocate == nullptr)
+		{
+			std::abort();
+		}
+		if (capacity > std::numeric_limits<uint16_t>::max())
+		{
+			capacity = std::numeric_limits<uint16_t>::max();
+		}
+
+		int32_t *span = static_cast<int32_t *>(m_Allocate->allocate(sizeof(int32_t) * capacity, alignof(int32_t)));
+		for (uint16_t i = 0; i < m_ChildCount; ++i)
+		{
+			span[i] = IsSpilled() ? GetSpan()[i] : m_Children[i];
+		}
+
+		ptrdiff_t p = (intptr_t)span - (intptr_t)this;
+		assert(p > std::numeric_limits<int32_t>::min() && p < std::numeric_limits<int32_t>::max());
+		m_Span = static_cast<int32_t>(p);
+		m_Capacity = static_cast<uint16_t>(capacity);
+	}
+
+public:
+	uint16_t m_Children[k_MaxChildrenPerComposite];
+	uint16_t m_ChildCount;
+	uint16_t m_Capacity;
+	int32_t m_Span;
+	CBehaviorAllocate *m_Allocate;
+};
+
+// Ͻڵ㹤
+template <class TASK>
+class CMockComposite :public CComposite
+{
+public:
+	void Initialize(CBehaviorAllocate &tree, size_t size)
+	{
+		CComposite::Reserve(tree, CComposite::GetChildCount() + size);
+		for (size_t i = 0; i < size; ++i)
+		{
+			CMockNode &n = tree.allocate<CMockNode>();
+			CComposite::AddChild(n);
+		}
+	}
+
+	virtual CTask *Create(CBehaviorTree *bt)
+	{
+		return CreateTask<TASK>(*this, bt);
+	}
+
+	virtual void Destroy(CTask *task)
+	{
+		DestroyTask<TASK>(task);
+	}
+
+	// нڵӽڵͬʱ,ӽڵ
+	virtual void Measure(STaskDemand &demand) const
+	{
+		if (TASK::k_Kind == NODE_PARALLEL || TASK::k_Kind == NODE_MONITOR)
+		{
+			for (uint16_t i = 0; i < CComposite::GetChildCount(); ++i)
+			{
+				CComposite::GetChild(i).Measure(demand);
+			}
+		}
+		else if (TASK::k_Kind == NODE_ACTIVESELECTOR)
+		{
+			// ȼ֧ʱ,ǰ֧Ȼ
+			CComposite::Measure(demand);
+			CComposite::Measure(demand);
+		}
+		else
+		{
+			CComposite::Measure(demand);
+		}
+		demand.Add<TASK>();
+	}
+
+	virtual eNodeKind GetKind() const
+	{
+		return TASK::k_Kind;
+	}
+};
+
+// нڵ
+// ˳,һʧ,򷵻
+// Ҫгɹ,򷵻سɹ,򷵻ʧ
+class CSequence :public CTask
+{
+public:
+	CSequence(CComposite &node) :
+		CTask(node)
+	{
+	}
+
+	static const eNodeKind k_Kind = NODE_SEQUENCE;
+	typedef CSequence Self;
+	typedef CTask Base;
+
+	CComposite &GetNode()
+	{
+		return *static_cast<CComposite *>(m_Node);
+	}
+
+	virtual void OnInitialize()
+	{
+		m_CurrentIndex = 0;
+		m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex), m_BehaviorTree);
+	}
+
+	// ¼: һӽڵ,֮onChildCompleteƽ
+	virtual bool OnStart(CBehavior &owner)
+	{
+		m_Owner = &owner;
+		OnInitialize();
+
+		BehaviorObserver observer = BehaviorObserver::Bind<CSequence, &CSequence::onChildComplete>(this);
+		m_BehaviorTree->Start(m_CurrentBehavior, &observer);
+		return true;
+	}
+
+	// Stop֪ͨڵ,ڵ漴ٱ,֮ٷʳԱ
+	void onChildComplete(eStatus)
+	{
+		CBehavior &child = m_CurrentBehavior;
+		if (child.m_Status == BH_FAILURE)
+		{
+			m_BehaviorTree->Stop(*m_Owner, BH_FAILURE);
+			return;
+		}
+
+		assert(child.m_Status == BH_SUCCESS);
+		if (++m_CurrentIndex == GetNode().GetChildCount())
+		{
+			m_BehaviorTree->Stop(*m_Owner, BH_SUCCESS);
+		}
+		else
+		{
+			BehaviorObserver observer = BehaviorObserver::Bind<CSequence, &CSequence::onChildComplete>(this);
+			m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex), m_BehaviorTree);
+			m_BehaviorTree->Start(m_CurrentBehavior, &observer);
+		}
+	}
+
+	virtual eStatus Update()
+	{
+		for (;;)
+		{
+			eStatus s = m_CurrentBehavior.Tick();
+
+			if (s != BH_SUCCESS)
+			{
+				// ɹˣһ򷵻
+				return s;
+			}
+
+			if (++m_CurrentIndex == GetNode().GetChildCount())
+			{
+				// нڵгɹ
+				return BH_SUCCESS;
+			}
+
+			m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex), m_BehaviorTree);
+		}
+	}
+
+	virtual void Save(CSnapshotWriter &writer) const
+	{
+		writer.Write(m_CurrentIndex);
+		m_CurrentBehavior.Save(writer);
+	}
+
+	virtual bool Load(CSnapshotReader &reader)
+	{
+		m_CurrentIndex = static_cast<uint16_t>(reader.Read(GetNode().GetChildCount()));
+		m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex), m_BehaviorTree);
+		return !reader.IsFailed() && m_CurrentBehavior.Load(reader);
+	}
+
+	CBehavior m_CurrentBehavior;
+	uint16_t m_CurrentIndex;
+	CBehavior *m_Owner;
+};
+
+typedef CMockComposite<CSequence> CMockSequence;
+
+void testsequence()
+{
+	CBehaviorTree bt;
+	CBehaviorAllocate t;
+	CMockSequence &se = t.allocate<CMockSequence>();
+
+	se.Initialize(t, 2);
+
+	CBehavior b;
+	b.Setup(se, &bt);
+
+	bt.Start(b);
+	bt.Tick();
+}
+
+// ѡ׶
+// ˳,һɹֱӷ
+// ֻҪһгɹ,򷵻سɹ,򷵻ʧ
+class CSelector :public CTask
+{
+public:
+	CSelector(CComposite &node) :
+		CTask(node)
+	{
+	}
+
+	static const eNodeKind k_Kind = NODE_SELECTOR;
+	typedef CSelector Self;
+	typedef CTask Base;
+
+protected:
+	CComposite & GetNode()
+	{
+		return *static_cast<CComposite*>(m_Node);
+	}
+
+	virtual void OnInitialize()
+	{
+		m_CurrentIndex = 0;
+		m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex), m_BehaviorTree);
+	}
+
+	// ¼: һӽڵ,֮onChildCompleteƽ
+	virtual bool OnStart(CBehavior &owner)
+	{
+		m_Owner = &owner;
+		OnInitialize();
+
+		BehaviorObserver observer = BehaviorObserver::Bind<CSelector, &CSelector::onChildComplete>(this);
+		m_BehaviorTree->Start(m_CurrentBehavior, &observer);
+		return true;
+	}
+
+	void onChildComplete(eStatus)
+	{
+		CBehavior &child = m_CurrentBehavior;
+		if (child.m_Status == BH_SUCCESS)
+		{
+			m_BehaviorTree->Stop(*m_Owner, BH_SUCCESS);
+			return;
+		}
+
+		assert(child.m_Status == BH_FAILURE);
+		if (++m_CurrentIndex == GetNode().GetChildCount())
+		{
+			m_BehaviorTree->Stop(*m_Owner, BH_FAILURE);
+		}
+		else
+		{
+			BehaviorObserver observer = BehaviorObserver::Bind<CSelector, &CSelector::onChildComplete>(this);
+			m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex), m_BehaviorTree);
+			m_BehaviorTree->Start(m_CurrentBehavior, &observer);
+		}
+	}
+
+	virtual eStatus Update()
+	{
+		for (;;)
+		{
+			eStatus s = m_CurrentBehavior.Tick();
+
+			if (s != BH_FAILURE)
+			{
+				// ʧˣһ򷵻
+				return s;
+			}
+
+			if (++m_CurrentIndex == GetNode().GetChildCount())
+			{
+				// нڵʧ
+				return BH_FAILURE;
+			}
+
+			m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex), m_BehaviorTree);
+		}
+	}
+
+	virtual void Save(CSnapshotWriter &writer) const
+	{
+		writer.Write(m_CurrentIndex);
+		m_CurrentBehavior.Save(writer);
+	}
+
+	virtual bool Load(CSnapshotReader &reader)
+	{
+		m_CurrentIndex = static_cast<uint16_t>(reader.Read(GetNode().GetChildCount()));
+		m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex), m_BehaviorTree);
+		return !reader.IsFailed() && m_CurrentBehavior.Load(reader);
+	}
+
+	CBehavior m_CurrentBehavior;
+	uint16_t m_CurrentIndex;
+	CBehavior *m_Owner;
+};
+
+typedef CMockComposite<CSelector> CMockSelector;
+
+void testselector()
+{
+	CBehaviorTree bt;
+	CBehaviorAllocate t;
+	CMockSelector &se = t.allocate<CMockSelector>();
+	se.Initialize(t, 2);
+	CBehavior b(se, &bt);
+	bt.Start(b);
+	bt.Tick();
+}
+
+// нڵ
+// ȫ,ɹʧܸʱ,
+// ʧӦڳɹ
+class CParallel :public CTask
+{
+public:
+	enum ePolicy
+	{
+		RequireOne,	//
+		RequireAll,	//ȫ
+	};
+
+	// Ĭȡڵ,MakeParam
+	CParallel(CComposite &node) :
+		CTask(node),
+		m_SuccessPolicy(static_cast<ePolicy>(node.GetParam() & 1)),
+		m_FailruePolicy(static_cast<ePolicy>((node.GetParam() >> 1) & 1)),
+		m_Overflow(nullptr)
+	{
+	}
+
+	virtual ~CParallel()
+	{
+		if (m_Overflow != nullptr)
+		{
+			DestroyTaskArray(m_BehaviorTree, m_Overflow, GetNode().GetChildCount() - k_MaxChildrenPerComposite);
+		}
+	}
+
+	static const eNodeKind k_Kind = NODE_PARALLEL;
+	typedef CParallel Self;
+	typedef CTask Base;
+
+	static uint32_t MakeParam(ePolicy forSuccess, ePolicy forFailure)
+	{
+		return forSuccess | (forFailure << 1);
+	}
+
+	// ɹ,ʧ
+	CParallel(CComposite &node, ePolicy forSuccess, ePolicy forFailure) :
+		m_SuccessPolicy(forSuccess),
+		m_FailruePolicy(forFailure),
+		CTask(node),
+		m_Overflow(nullptr)
+	{
+
+	}
+
+	void SetPolicy(ePolicy forSuccess, ePolicy forFailure)
+	{
+		m_SuccessPolicy = forSuccess;
+		m_FailruePolicy = forFailure;
+	}
+
+	CComposite &GetNode()
+	{
+		return *static_cast<CComposite*>(m_Node);
+	}
+
+	// indexӽڵΪ
+	CBehavior &GetBehavior(uint16_t index)
+	{
+		assert(index < GetNode().GetChildCount());
+		if (index < k_MaxChildrenPerComposite)
+		{
+			return m_Behaviors[index];
+		}
+		return m_Overflow[index - k_MaxChildrenPerComposite];
+	}
+
+protected:
+	// ÿӽڵһΪ,ʱ,֮һֱ´μ
+	virtual void OnInitialize()
+	{
+		uint16_t count = GetNode().GetChildCount();
+		if (count > k_MaxChildrenPerComposite && m_Overflow == nullptr)
+		{
+			// ӽڵ㳬ʱ,һμʱӴȡ,ٺһ
+			m_Overflow = CreateTaskArray<CBehavior>(m_BehaviorTree, count - k_MaxChildrenPerComposite);
+		}
+
+		for (uint16_t i = 0; i < count; ++i)
+		{
+			GetBehavior(i).Setup(GetNode().GetChild(i), m_BehaviorTree);
+			GetBehavior(i).Rest();
+		}
+	}
+
+	virtual eStatus Update()
+	{
+		return UpdateChildren([](uint16_t) { return true; });
+	}
+
+	// needTick(i)falseʱiӽڵ㱾βTick,ϴε״̬
+	template <class NEEDTICK>
+	eStatus UpdateChildren(NEEDTICK needTick)
+	{
+		size_t nSuccessCount = 0, nFailureCount = 0;
+		for (uint16_t i = 0; i < GetNode().GetChildCount(); ++i)
+		{
+			CBehavior &behavior = GetBehavior(i);
+			if (!behavior.IsTerminated() && needTick(i))
+			{
+				behavior.Tick();
+			}
+
+			if (behavior.GetStatus() == BH_SUCCESS)
+			{
+				// ɹһ
+				++nSuccessCount;
+				if (m_SuccessPolicy == RequireOne)
+				{
+					// ֻҪһγɹ򷵻سɹ
+					return BH_SUCCESS;
+				}
+			}
+
+			if (behavior.GetStatus() == BH_FAILURE)
+			{
+				// ʧһ
+				++nFailureCount;
+				if (m_FailruePolicy == RequireOne)
+				{
+					// ֻҪʧһ򷵻ʧ
+					return BH_FAILURE;
+				}
+			}
+		}
+
+		if (m_FailruePolicy == RequireAll && nFailureCount == GetNode().GetChildCount())
+		{
+			// ȫʧ
+			return BH_FAILURE;
+		}
+
+		if (m_SuccessPolicy == RequireAll && nSuccessCount == GetNode().GetChildCount())
+		{
+			// ȫɹ
+			return BH_SUCCESS;
+		}
+
+		// нڵ㴦Running
+		return BH_RUNNING;
+	}
+
+	// ֻеӽڵ
+	virtual void OnTerminate(eStatus)
+	{
+		for (uint16_t i = 0; i < GetNode().GetChildCount(); ++i)
+		{
+			if (GetBehavior(i).IsActive())
+			{
+				GetBehavior(i).Abort();
+			}
+		}
+	}
+
+	virtual void Save(CSnapshotWriter &writer) const
+	{
+		CParallel &self = const_cast<CParallel &>(*this);
+		writer.Write(MakeParam(m_SuccessPolicy, m_FailruePolicy));
+		for (uint16_t i = 0; i < self.GetNode().GetChildCount(); ++i)
+		{
+			self.GetBehavior(i).Save(writer);
+		}
+	}
+
+	// 汾,ֵָһ
+	virtual bool Load(CSnapshotReader &reader)
+	{
+		uint32_t param = reader.Read(4);
+		m_SuccessPolicy = static_cast<ePolicy>(param & 1);
+		m_FailruePolicy = static_cast<ePolicy>((param >> 1) & 1);
+		OnInitialize();
+
+		for (uint16_t i = 0; i < GetNode().GetChildCount(); ++i)
+		{
+			if (!GetBehavior(i).Load(reader))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+protected:
+	ePolicy m_SuccessPolicy;
+	ePolicy m_FailruePolicy;
+	CBehavior m_Behaviors[k_MaxChildrenPerComposite];
+	CBehavior *m_Overflow;
+};
+
+typedef CMockComposite<CParallel> CMockParallel;
+
+void testparallel()
+{
+	CBehaviorTree bt;
+	CBehaviorAllocate t;
+	CMockParallel &p = t.allocate<CMockParallel>();
+	p.Initialize(t, 2);
+	CBehavior b(p, &bt);
+	b.Get<CParallel>()->SetPolicy(CParallel::RequireAll, CParallel::RequireOne);
+	bt.Start(b);
+	bt.Tick();
+}
+
+// 
+// ΪнڵӼ
+class CMonitor :public CParallel
+{
+public:
+	CMonitor(CComposite &node) :
+		CParallel(node, CParallel::RequireOne, CParallel::RequireOne),
+		m_StampOverflow(nullptr)
+	{
+	}
+
+	virtual ~CMonitor()
+	{
+		if (m_StampOverflow != nullptr)
+		{
+			DestroyTaskArray(m_BehaviorTree, m_StampOverflow, GetNode().GetChildCount() - k_MaxChildrenPerComposite);
+		}
+	}
+
+	static const eNodeKind k_Kind = NODE_MONITOR;
+	typedef CMonitor Self;
+	typedef CParallel Base;
+
+	// ӿʼ
+	void AddCondition(CNode &condition)
+	{
+		GetNode().AddChildFront(condition);
+	}
+
+	// Ӷ
+	void AddAction(CNode &action)
+	{
+		GetNode().AddChild(action);
+	}
+
+protected:
+	virtual void OnInitialize()
+	{
+		CParallel::OnInitialize();
+		uint16_t count = GetNode().GetChildCount();
+		if (count > k_MaxChildrenPerComposite && m_StampOverflow == nullptr)
+		{
+			// Ϊһ,ĲִӴȡ
+			m_StampOverflow = CreateTaskArray<uint32_t>(m_BehaviorTree, count - k_MaxChildrenPerComposite);
+		}
+		for (uint16_t i = 0; i < count; ++i)
+		{
+			GetStamp(i) = 0;
+		}
+	}
+
+	// ,ļûиıʱ,ظֵ
+	virtual eStatus Update()
+	{
+		return UpdateChildren([this](uint16_t i) { return NeedTick(i); });
+	}
+
+	bool NeedTick(uint16_t i)
+	{
+		SDependencies dependencies;
+		if (!GetNode().GetChild(i).GetDependencies(dependencies))
+		{
+			return true;
+		}
+
+		uint32_t stamp = StampDependencies(m_BehaviorTree->GetBlackboard(), dependencies);
+		if (stamp == GetStamp(i) && GetBehavior(i).IsRunning())
+		{
+			return false;
+		}
+		GetStamp(i) = stamp;
+		return true;
+	}
+
+	uint32_t &GetStamp(uint16_t i)
+	{
+		return i < k_MaxChildrenPerComposite ? m_Stamps[i] : m_StampOverflow[i - k_MaxChildrenPerComposite];
+	}
+
+	// ϴֵʱ汾
+	uint32_t m_Stamps[k_MaxChildrenPerComposite];
+	uint32_t *m_StampOverflow;
+};
+
+typedef CMockComposite<CMonitor> CMockMonitor;
+
+void testmonitor()
+{
+	CBehaviorTree bt;
+	CBehaviorAllocate t;
+	CMockMonitor &m = t.allocate<CMockMonitor>();
+	m.Initialize(t, 2);
+	CBehavior b(m, &bt);
+	bt.Start(b);
+	bt.Tick();
+}
+
+// ѡ
+class CActiveSelector :public CSelector
+{
+public:
+	CActiveSelector(CComposite &node) :
+		CSelector(node),
+		m_StampOverflow(nullptr)
+	{
+	}
+
+	virtual ~CActiveSelector()
+	{
+		if (m_StampOverflow != nullptr)
+		{
+			DestroyTaskArray(m_BehaviorTree, m_StampOverflow, GetNode().GetChildCount() - k_MaxChildrenPerComposite);
+		}
+	}
+
+	static const eNodeKind k_Kind = NODE_ACTIVESELECTOR;
+	typedef CActiveSelector Self;
+	typedef CSelector Base;
+
+	// ÿζҪͷȼ,ֻѯ
+	virtual bool OnStart(CBehavior &)
+	{
+		return false;
+	}
+
+	// ǰ֧ʱԼȻ,ÿ֡ѯܼȼ֧
+	// ķ֧ٴTickʱ³ʼ,ȴع
+	static eStatus Poll(eStatus s)
+	{
+		return s == BH_SUSPENDED ? BH_RUNNING : s;
+	}
+
+protected:
+	virtual void OnInitialize()
+	{
+		uint16_t count = GetNode().GetChildCount();
+		m_CurrentIndex = count;
+		if (count > k_MaxChildrenPerComposite && m_StampOverflow == nullptr)
+		{
+			m_StampOverflow = CreateTaskArray<uint32_t>(m_BehaviorTree, count - k_MaxChildrenPerComposite);
+		}
+		for (uint16_t i = 0; i < count; ++i)
+		{
+			GetStamp(i) = 0;
+		}
+	}
+
+	// Ȱȼڵǰӽڵ֮ǰķ֧,еľֹǰ֧Ϊ
+	// ǰ֧ʧܺγԺķ֧
+	// ķ֧ʧܺ汾,汾Ͳֵ
+	virtual eStatus Update()
+	{
+		uint16_t count = GetNode().GetChildCount();
+		for (uint16_t i = 0; i < m_CurrentIndex; ++i)
+		{
+			if (IsUnchanged(i))
+			{
+				continue;
+			}
+
+			m_Probe.Setup(GetNode().GetChild(i), m_BehaviorTree);
+			eStatus s = m_Probe.Tick();
+			if (s == BH_FAILURE)
+			{
+				Remember(i);
+				continue;
+			}
+
+			if (m_CurrentIndex != count && m_CurrentBehavior.IsActive())
+			{
+				m_CurrentBehavior.Abort();
+			}
+			m_CurrentBehavior.Swap(m_Probe);
+			m_CurrentIndex = i;
+			return Poll(s);
+		}
+
+		if (m_CurrentIndex == count)
+		{
+			return BH_FAILURE;
+		}
+
+		eStatus s = m_CurrentBehavior.Tick();
+		while (s == BH_FAILURE)
+		{
+			Remember(m_CurrentIndex);
+			if (++m_CurrentIndex == count)
+			{
+				return BH_FAILURE;
+			}
+
+			if (IsUnchanged(m_CurrentIndex))
+			{
+				continue;
+			}
+
+			m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex), m_BehaviorTree);
+			s = m_CurrentBehavior.Tick();
+		}
+		return Poll(s);
+	}
+
+	virtual void OnTerminate(eStatus)
+	{
+		if (m_CurrentBehavior.IsActive())
+		{
+			m_CurrentBehavior.Abort();
+		}
+	}
+
+	// ǰ֧±ӽڵʾûеķ֧
+	virtual void Save(CSnapshotWriter &writer) const
+	{
+		writer.Write(m_CurrentIndex);
+		if (m_CurrentIndex != const_cast<CActiveSelector *>(this)->GetNode().GetChildCount())
+		{
+			m_CurrentBehavior.Save(writer);
+		}
+	}
+
+	// 汾,ֵָ֧һ
+	virtual bool Load(CSnapshotReader &reader)
+	{
+		OnInitialize();
+		uint16_t count = GetNode().GetChildCount();
+		m_CurrentIndex = static_cast<uint16_t>(reader.Read(count + 1));
+		if (m_CurrentIndex != count)
+		{
+			m_CurrentBehavior.Setup(GetNode().GetChild(m_CurrentIndex), m_BehaviorTree);
+			return m_CurrentBehavior.Load(reader);
+		}
+		return !reader.IsFailed();
+	}
+
+	// ֧ϴʧܺļûб,ʧ
+	bool IsUnchanged(uint16_t i)
+	{
+		SDependencies dependencies;
+		if (GetStamp(i) == 0 || !GetNode().GetChild(i).GetDependencies(dependencies))
+		{
+			return false;
+		}
+		return StampDependencies(m_BehaviorTree->GetBlackboard(), dependencies) == GetStamp(i);
+	}
+
+	void Remember(uint16_t i)
+	{
+		SDependencies dependencies;
+		if (GetNode().GetChild(i).GetDependencies(dependencies))
+		{
+			GetStamp(i) = StampDependencies(m_BehaviorTree->GetBlackboard(), dependencies);
+		}
+	}
+
+	uint32_t &GetStamp(uint16_t i)
+	{
+		return i < k_MaxChildrenPerComposite ? m_Stamps[i] : m_StampOverflow[i - k_MaxChildrenPerComposite];
+	}
+
+	// ȼ֧õΪ,ʱ뵱ǰΪ
+	CBehavior m_Probe;
+	// ֧ϴʧʱ汾
+	uint32_t m_Stamps[k_MaxChildrenPerComposite];
+	uint32_t *m_StampOverflow;
+};
+
+typedef CMockComposite<CActiveSelector> CMockActiveSelector;
+
+void testactiveselector()
+{
+	CBehaviorTree bt;
+	CBehaviorAllocate t;
+	CMockActiveSelector &a = t.allocate<CMockActiveSelector>();
+	a.Initialize(t, 2);
+	CBehavior b(a, &bt);
+	bt.Start(b);
+	bt.Tick();
+}
+
+// Get<>ID,ȡĻ
+void testtasktype()
+{
+	CBehaviorTree bt;
+	CBehaviorAllocate t;
+	CMockMonitor &m = t.allocate<CMockMonitor>();
+	m.Initialize(t, 2);
+	CBehavior b(m, &bt);
+	bt.Start(b);
+	bt.Tick();
+	assert(b.Get<CMonitor>() != nullptr);
+	assert(b.Get<CParallel>() == b.Get<CMonitor>());
+	assert(b.Get<CTask>() != nullptr);
+	assert(b.Get<CSelector>() == nullptr);
+	assert(b.Get<CParallel>()->GetBehavior(0).Get<CMockTask>() != nullptr);
+	assert(b.Get<CParallel>()->GetBehavior(0).Get<CRepeat>() == nullptr);
+
+	CMockActiveSelector &a = t.allocate<CMockActiveSelector>();
+	a.Initialize(t, 2);
+	CBehavior c(a, &bt);
+	assert(c.Get<CSelector>() != nullptr);
+	assert(c.Get<CSequence>() == nullptr);
+
+	CBehavior d;
+	assert(d.Get<CTask>() == nullptr);
+}
+
+#if BH_PROFILE
+
+void CProfiler::Walk(const CNode &node, int parent, std::vector<SEntry> &entries)
+{
+	SEntry entry = { &node, parent };
+	int id = static_cast<int>(entries.size());
+	entries.push_back(entry);
+
+	switch (node.GetKind())
+	{
+	case NODE_LEAF:
+		break;
+	case NODE_REPEAT:
+		Walk(static_cast<const CDecorator &>(node).GetChild(), id, entries);
+		break;
+	default:
+	{
+		const CComposite &composite = static_cast<const CComposite &>(node);
+		for (uint16_t i = 0; i < composite.GetChildCount(); ++i)
+		{
+			Walk(composite.GetChild(i), id, entries);
+		}
+		break;
+	}
+	}
+}
+
+static const char *const k_KindNames[] = { "leaf", "sequence", "selector", "parallel", "monitor", "activeselector", "repeat" };
+
+void CProfiler::DumpCSV(FILE *file, const CNode &root) const
+{
+	std::vector<SEntry> entries;
+	Walk(root, -1, entries);
+
+	fprintf(file, "id,parent,kind,calls,inclusive,exclusive,success,failure,running,aborted,created,destroyed\n");
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		SNodeProfile p = Get(*entries[i].m_Node);
+		fprintf(file, "%d,%d,%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+			static_cast<int>(i), entries[i].m_Parent, k_KindNames[entries[i].m_Node->GetKind()],
+			(unsigned long long)p.m_Calls, (unsigned long long)p.m_Inclusive, (unsigned long long)p.m_Exclusive,
+			(unsigned long long)p.m_Status[BH_SUCCESS], (unsigned long long)p.m_Status[BH_FAILURE],
+			(unsigned long long)p.m_Status[BH_RUNNING], (unsigned long long)p.m_Status[BH_ABORTED],
+			(unsigned long long)p.m_Created, (unsigned long long)p.m_Destroyed);
+	}
+}
+
+void CProfiler::DumpJSON(FILE *file, const CNode &root) const
+{
+	std::vector<SEntry> entries;
+	Walk(root, -1, entries);
+
+	fprintf(file, "[\n");
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		SNodeProfile p = Get(*entries[i].m_Node);
+		fprintf(file, "\t{\"id\":%d,\"parent\":%d,\"kind\":\"%s\",\"calls\":%llu,\"inclusive\":%llu,\"exclusive\":%llu,"
+			"\"status\":{\"success\":%llu,\"failure\":%llu,\"running\":%llu,\"aborted\":%llu},\"created\":%llu,\"destroyed\":%llu}%s\n",
+			static_cast<int>(i), entries[i].m_Parent, k_KindNames[entries[i].m_Node->GetKind()],
+			(unsigned long long)p.m_Calls, (unsigned long long)p.m_Inclusive, (unsigned long long)p.m_Exclusive,
+			(unsigned long long)p.m_Status[BH_SUCCESS], (unsigned long long)p.m_Status[BH_FAILURE],
+			(unsigned long long)p.m_Status[BH_RUNNING], (unsigned long long)p.m_Status[BH_ABORTED],
+			(unsigned long long)p.m_Created, (unsigned long long)p.m_Destroyed,
+			i + 1 < entries.size() ? "," : "");
+	}
+	fprintf(file, "]\n");
+}
+
+#endif
+
+// ̬Ϊ
+// Ľṹģ,Sequence<Cond<A>, Selector<B, Repeat<C, 3>>>
+// Tickڱչһ,û麯,Ͻڵ״ֻ̬еǰӽڵ±
+// ǵȫ,contextΪԼ,ԭҶ
+//
+// ҶӶCStaticTask,ʵUpdate(context),踲OnInitialize/OnTerminate
+// Cond<A>Aʵbool operator()(context)
+// Subtree<GETNODE>ھ̬һö̬ڵͼ,CStaticTreeNode<TREE>Ѿ̬Ž̬ڵͼ
+struct CStaticTask
+{
+	template <class CONTEXT>
+	void OnInitialize(CONTEXT &)
+	{
+	}
+
+	template <class CONTEXT>
+	void OnTerminate(CONTEXT &, eStatus)
+	{
+	}
+};
+
+// ҶӶ,״̬
+template <class TASK>
+class Action
+{
+public:
+	typedef void StaticNodeTag;
+
+	Action() :
+		m_Status(BH_INVALID)
+	{
+	}
+
+	template <class CONTEXT>
+	eStatus Tick(CONTEXT &context)
+	{
+		if (m_Status != BH_RUNNING && m_Status != BH_SUSPENDED)
+		{
+			m_Task.OnInitialize(context);
+		}
+
+		eStatus status = m_Task.Update(context);
+		m_Status = static_cast<uint8_t>(status);
+
+		if (status != BH_RUNNING && status != BH_SUSPENDED)
+		{
+			m_Task.OnTerminate(context, status);
+		}
+		return status;
+	}
+
+	template <class CONTEXT>
+	void Abort(CONTEXT &context)
+	{
+		if (m_Status == BH_RUNNING || m_Status == BH_SUSPENDED)
+		{
+			m_Task.OnTerminate(context, BH_ABORTED);
+			m_Status = BH_ABORTED;
+		}
+	}
+
+	TASK &GetTask()
+	{
+		return m_Task;
+	}
+
+	eStatus GetStatus() const
+	{
+		return static_cast<eStatus>(m_Status);
+	}
+
+protected:
+	TASK m_Task;
+	uint8_t m_Status;
+};
+
+// ģûStaticNodeTagͶҶӶ
+// ùĿջ,ͬ͵Ŀջ಻ص,Ƕ׵Ľڵ
+template <class T, class TAG = void>
+struct StaticNode
+{
+	typedef Action<T> Type;
+};
+
+template <class T>
+struct StaticNode<T, typename std::conditional<true, void, typename T::StaticNodeTag>::type>
+{
+	typedef T Type;
+};
+
+// ,û״̬
+template <class CONDITION>
+class Cond
+{
+public:
+	typedef void StaticNodeTag;
+
+	template <class CONTEXT>
+	eStatus Tick(CONTEXT &context)
+	{
+		return m_Condition(context) ? BH_SUCCESS : BH_FAILURE;
+	}
+
+	template <class CONTEXT>
+	void Abort(CONTEXT &)
+	{
+	}
+
+protected:
+	CONDITION m_Condition;
+};
+
+// кѡ,ӽڵ㷵CONTINUEʱһ,򷵻ظ״̬
+template <eStatus CONTINUE, class... CHILDREN>
+class CStaticComposite
+{
+public:
+	typedef void StaticNodeTag;
+
+	typedef std::tuple<typename StaticNode<CHILDREN>::Type...> Children;
+	static const size_t k_Count = sizeof...(CHILDREN);
+	static_assert(k_Count > 0 && k_Count < 256, "static composite needs 1-255 children");
+
+	CStaticComposite() :
+		m_Current(0)
+	{
+	}
+
+	template <class CONTEXT>
+	eStatus Tick(CONTEXT &context)
+	{
+		return TickFrom(context, std::integral_constant<size_t, 0>());
+	}
+
+	template <class CONTEXT>
+	void Abort(CONTEXT &context)
+	{
+		AbortFrom(context, std::integral_constant<size_t, 0>());
+		m_Current = 0;
+	}
+
+	template <size_t INDEX>
+	typename std::tuple_element<INDEX, Children>::type &GetChild()
+	{
+		return std::get<INDEX>(m_Children);
+	}
+
+	size_t GetCurrentIndex() const
+	{
+		return m_Current;
+	}
+
+protected:
+	template <class CONTEXT, size_t INDEX>
+	eStatus TickFrom(CONTEXT &context, std::integral_constant<size_t, INDEX>)
+	{
+		if (m_Current == INDEX)
+		{
+			eStatus s = std::get<INDEX>(m_Children).Tick(context);
+			if (s != CONTINUE)
+			{
+				if (s != BH_RUNNING && s != BH_SUSPENDED)
+				{
+					m_Current = 0;
+				}
+				return s;
+			}
+			m_Current = INDEX + 1;
+		}
+		return TickFrom(context, std::integral_constant<size_t, INDEX + 1>());
+	}
+
+	template <class CONTEXT>
+	eStatus TickFrom(CONTEXT &, std::integral_constant<size_t, k_Count>)
+	{
+		m_Current = 0;
+		return CONTINUE;
+	}
+
+	template <class CONTEXT, size_t INDEX>
+	void AbortFrom(CONTEXT &context, std::integral_constant<size_t, INDEX>)
+	{
+		if (m_Current == INDEX)
+		{
+			std::get<INDEX>(m_Children).Abort(context);
+			return;
+		}
+		AbortFrom(context, std::integral_constant<size_t, INDEX + 1>());
+	}
+
+	template <class CONTEXT>
+	void AbortFrom(CONTEXT &, std::integral_constant<size_t, k_Count>)
+	{
+	}
+
+	Children m_Children;
+	uint8_t m_Current;
+};
+
+template <class... CHILDREN>
+using Sequence = CStaticComposite<BH_SUCCESS, CHILDREN...>;
+
+template <class... CHILDREN>
+using Selector = CStaticComposite<BH_FAILURE, CHILDREN...>;
+
+// ظCOUNT,ӽڵʧʧ
+template <class CHILD, uint32_t COUNT>
+class Repeat
+{
+public:
+	typedef void StaticNodeTag;
+
+	Repeat() :
+		m_Counter(0)
+	{
+	}
+
+	template <class CONTEXT>
+	eStatus Tick(CONTEXT &context)
+	{
+		for (;;)
+		{
+			eStatus s = m_Child.Tick(context);
+			if (s == BH_RUNNING || s == BH_SUSPENDED)
+			{
+				return s;
+			}
+
+			if (s == BH_FAILURE || ++m_Counter >= COUNT)
+			{
+				m_Counter = 0;
+				return s;
+			}
+		}
+	}
+
+	template <class CONTEXT>
+	void Abort(CONTEXT &context)
+	{
+		m_Child.Abort(context);
+		m_Counter = 0;
+	}
+
+	typename StaticNode<CHILD>::Type &GetChild()
+	{
+		return m_Child;
+	}
+
+protected:
+	typename StaticNode<CHILD>::Type m_Child;
+	uint32_t m_Counter;
+};
+
+// ̬еĶ̬,һTickʱGETNODE(context)ȡýڵ
+// contextΪCBehaviorTreeʱӸôش
+inline CBehaviorTree *GetContextTree(CBehaviorTree &bt)
+{
+	return &bt;
+}
+
+template <class CONTEXT>
+CBehaviorTree *GetContextTree(CONTEXT &)
+{
+	return nullptr;
+}
+
+template <class GETNODE>
+class Subtree
+{
+public:
+	typedef void StaticNodeTag;
+
+	template <class CONTEXT>
+	eStatus Tick(CONTEXT &context)
+	{
+		if (m_Behavior.m_Task == nullptr)
+		{
+			m_Behavior.Setup(GETNODE()(context), GetContextTree(context));
+		}
+		return m_Behavior.Tick();
+	}
+
+	template <class CONTEXT>
+	void Abort(CONTEXT &)
+	{
+		if (m_Behavior.IsActive())
+		{
+			m_Behavior.Abort();
+		}
+	}
+
+	CBehavior &GetBehavior()
+	{
+		return m_Behavior;
+	}
+
+protected:
+	CBehavior m_Behavior;
+};
+
+// Ծ̬ΪĽڵ,contextΪĴ
+template <class TREE>
+class CStaticTree :public CTask
+{
+public:
+	CStaticTree(CNode &node) :
+		CTask(node)
+	{
+	}
+
+	typedef CStaticTree Self;
+	typedef CTask Base;
+
+	// ̬Ǵ,ûдʱ޷
+	virtual eStatus Update()
+	{
+		if (m_BehaviorTree == nullptr)
+		{
+			return BH_FAILURE;
+		}
+		return m_Tree.Tick(*m_BehaviorTree);
+	}
+
+	virtual void OnTerminate(eStatus status)
+	{
+		if (status == BH_ABORTED && m_BehaviorTree != nullptr)
+		{
+			m_Tree.Abort(*m_BehaviorTree);
+		}
+	}
+
+	TREE &GetTree()
+	{
+		return m_Tree;
+	}
+
+protected:
+	TREE m_Tree;
+};
+
+template <class TREE>
+class CStaticTreeNode :public CNode
+{
+public:
+	virtual CTask *Create(CBehaviorTree *bt)
+	{
+		return CreateTask<CStaticTree<TREE> >(*this, bt);
+	}
+
+	virtual void Destroy(CTask *task)
+	{
+		DestroyTask<CStaticTree<TREE> >(task);
+	}
+
+	// SubtreeеĶ̬ڵʱȷ,ͳ
+	virtual void Measure(STaskDemand &demand) const
+	{
+		demand.Add<CStaticTree<TREE> >();
+	}
+};
+
+// ȴڵ
+// ÿμm_Ticks,Ȼ󷵻m_Result
+// ֻɽڵ,ڱȽϲִͬзʽ
+struct CWaitTask :public CTask
+{
+	CWaitTask(CNode &node) :
+		CTask(node),
+		m_Remaining(0)
+	{
+	}
+
+	typedef CWaitTask Self;
+	typedef CTask Base;
+
+	virtual void OnInitialize();
+	virtual eStatus Update();
+
+	virtual void Save(CSnapshotWriter &writer) const
+	{
+		writer.Write(m_Remaining);
+	}
+
+	virtual bool Load(CSnapshotReader &reader);
+
+	uint32_t m_Remaining;
+};
+
+struct CWaitNode :public CNode
+{
+	CWaitNode(uint32_t ticks = 0, eStatus result = BH_SUCCESS) :
+		m_Ticks(ticks),
+		m_Result(result)
+	{
+	}
+
+	virtual CTask *Create(CBehaviorTree *bt)
+	{
+		return CreateTask<CWaitTask>(*this, bt);
+	}
+
+	virtual void Destroy(CTask *task)
+	{
+		DestroyTask<CWaitTask>(task);
+	}
+
+	virtual void Measure(STaskDemand &demand) const
+	{
+		demand.Add<CWaitTask>();
+	}
+
+	uint32_t m_Ticks;
+	eStatus m_Result;
+};
+
+void CWaitTask::OnInitialize()
+{
+	m_Remaining = static_cast<CWaitNode *>(m_Node)->m_Ticks;
+}
+
+eStatus CWaitTask::Update()
+{
+	if (m_Remaining > 0)
+	{
+		--m_Remaining;
+		return BH_RUNNING;
+	}
+	return static_cast<CWaitNode *>(m_Node)->m_Result;
+}
+
+// ʣ֡ڵ֡
+bool CWaitTask::Load(CSnapshotReader &reader)
+{
+	m_Remaining = reader.Read();
+	return !reader.IsFailed() && m_Remaining <= static_cast<CWaitNode *>(m_Node)->m_Ticks;
+}
+
+// öʱֵȴ֡,ȴڼ,ڵȶ
+struct CSleepTask :public CTask
+{
+	CSleepTask(CNode &node) :
+		CTask(node),
+		m_Slept(false)
+	{
+	}
+
+	typedef CSleepTask Self;
+	typedef CTask Base;
+
+	virtual void OnInitialize()
+	{
+		m_Slept = false;
+	}
+
+	virtual eStatus Update();
+
+	virtual void OnTerminate(eStatus)
+	{
+		m_Timer.Cancel();
+	}
+
+	// ǷѾ˯ºʣ֡,ָʱڻָĸ¹Ҷʱ
+	virtual void Save(CSnapshotWriter &writer) const
+	{
+		writer.Write(m_Slept ? 1 : 0);
+		if (m_Slept)
+		{
+			writer.Write(m_Timer.IsPending() ? m_Timer.GetRemaining() : 0);
+		}
+	}
+
+	virtual bool Load(CSnapshotReader &reader);
+
+	CTimer m_Timer;
+	bool m_Slept;
+};
+
+struct CSleepNode :public CWaitNode
+{
+	CSleepNode(uint32_t frames = 0, eStatus result = BH_SUCCESS) :
+		CWaitNode(frames, result)
+	{
+	}
+
+	virtual CTask *Create(CBehaviorTree *bt)
+	{
+		return CreateTask<CSleepTask>(*this, bt);
+	}
+
+	virtual void Destroy(CTask *task)
+	{
+		DestroyTask<CSleepTask>(task);
+	}
+
+	virtual void Measure(STaskDemand &demand) const
+	{
+		demand.Add<CSleepTask>();
+	}
+};
+
+bool CSleepTask::Load(CSnapshotReader &reader)
+{
+	CWaitNode &node = *static_cast<CWaitNode *>(m_Node);
+	m_Slept = reader.Read(2) == 1;
+	uint32_t remaining = m_Slept ? reader.Read(node.m_Ticks + 1) : 0;
+	if (reader.IsFailed())
+	{
+		return false;
+	}
+
+	if (remaining != 0)
+	{
+		if (m_BehaviorTree == nullptr || reader.GetOwner() == nullptr)
+		{
+			return false;
+		}
+		m_BehaviorTree->Sleep(m_Timer, remaining, reader.GetOwner());
+	}
+	return true;
+}
+
+// ѯʱڵڵǰٴTick,Ȼع
+// ûдStepִʱûпԻָΪ,ֱʧ
+eStatus CSleepTask::Update()
+{
+	CWaitNode &node = *static_cast<CWaitNode *>(m_Node);
+	if (!m_Slept)
+	{
+		m_Slept = true;
+		if (node.m_Ticks != 0)
+		{
+			if (m_BehaviorTree == nullptr || m_BehaviorTree->GetCurrent() == nullptr)
+			{
+				return BH_FAILURE;
+			}
+			m_BehaviorTree->Sleep(m_Timer, node.m_Ticks);
+			return BH_SUSPENDED;
+		}
+	}
+	return m_Timer.IsPending() ? BH_SUSPENDED : node.m_Result;
+}
+
+void testtaskpool()
+{
+	CBehaviorAllocate t;
+	CMockSequence &se = t.allocate<CMockSequence>();
+	se.Reserve(t, 3);
+	for (int i = 0; i < 3; ++i)
+	{
+		se.AddChild(t.allocate<CWaitNode>(1, BH_SUCCESS));
+	}
+
+	// ͬһݽڵͼ,ֻԼ
+	const int k_Agents = 8;
+	CBehaviorTree bt[k_Agents];
+	CBehavior b[k_Agents];
+	for (int i = 0; i < k_Agents; ++i)
+	{
+		bt[i].Prepare(se);
+		b[i].Setup(se, &bt[i]);
+	}
+
+	eStatus s;
+	for (int round = 0; round < 4; ++round)
+	{
+		for (int i = 0; i < k_Agents; ++i)
+		{
+			for (uint16_t n = 0; n < se.GetChildCount(); ++n)
+			{
+				s = b[i].Tick();
+				assert(s == BH_RUNNING);
+			}
+			s = b[i].Tick();
+			assert(s == BH_SUCCESS);
+		}
+	}
+	(void)s;
+
+	// ͬʱֻкһӽڵ,Ԥڴ
+	for (int i = 0; i < k_Agents; ++i)
+	{
+		assert(bt[i].GetTaskPool().GetReservedSize() <= 2 * (sizeof(CSequence) + sizeof(CWaitTask)));
+		assert(bt[i].GetTaskPool().GetMisses() == 0);
+		assert(bt[i].GetTaskPool().GetHits() > 0);
+	}
+}
+
+struct alignas(64) CAlignedNode
+{
+	static int s_Destroyed;
+	uint8_t m_Data[100];
+	~CAlignedNode() { ++s_Destroyed; }
+};
+int CAlignedNode::s_Destroyed = 0;
+
+void testallocate()
+{
+	CBehaviorAllocate t;
+	for (int i = 0; i < 200; ++i)
+	{
+		t.allocate<uint8_t>();
+		CAlignedNode &n = t.allocate<CAlignedNode>();
+		assert((uintptr_t)&n % alignof(CAlignedNode) == 0);
+		(void)n;
+	}
+
+	// Сʱ¿
+	size_t capacity = t.capacity();
+	assert(capacity > k_MaxBehaviorTreeMemory);
+
+	// reset,еĿ
+	t.reset();
+	assert(CAlignedNode::s_Destroyed == 200);
+	for (int i = 0; i < 200; ++i)
+	{
+		t.allocate<uint8_t>();
+		t.allocate<CAlignedNode>();
+	}
+	assert(t.capacity() == capacity);
+	(void)capacity;
+
+	// ͬһڵĴС,ٰʵʴСһ뵽λ
+	CBehaviorAllocate measure;
+	CMockSequence &ms = measure.allocate<CMockSequence>();
+	ms.AddChild(measure.allocate<CMockRepeat>(&measure.allocate<CMockNode>()));
+	size_t expected = measure.size();
+
+	CBehaviorAllocate exact(expected);
+	CMockSequence &se = exact.allocate<CMockSequence>();
+	se.AddChild(exact.allocate<CMockRepeat>(&exact.allocate<CMockNode>()));
+	// ,û˵ûӵڶ
+	assert(exact.size() == expected);
+	assert(exact.capacity() == expected);
+	(void)expected;
+}
+
+void testwidecomposite()
+{
+	CBehaviorTree bt;
+	CBehaviorAllocate t;
+	CMockSelector &se = t.allocate<CMockSelector>();
+	se.Reserve(t, 40);
+	for (int i = 0; i < 40; ++i)
+	{
+		se.AddChild(t.allocate<CWaitNode>(1, BH_FAILURE));
+	}
+	assert(se.GetChildCount() == 40 && se.IsSpilled());
+
+	CBehavior b(se, &bt);
+	eStatus s;
+	for (uint16_t i = 0; i < se.GetChildCount(); ++i)
+	{
+		s = b.Tick();
+		assert(s == BH_RUNNING);
+	}
+	s = b.Tick();
+	assert(s == BH_FAILURE);
+
+	// Ϊȡ,ؽٷȫֶ
+	CMockParallel &p = t.allocate<CMockParallel>();
+	p.SetParam(CParallel::MakeParam(CParallel::RequireAll, CParallel::RequireOne));
+	p.Reserve(t, 12);
+	for (uint32_t i = 0; i < 12; ++i)
+	{
+		p.AddChild(t.allocate<CWaitNode>(1, BH_SUCCESS));
+	}
+
+	size_t misses = 0;
+	for (int round = 0; round < 3; ++round)
+	{
+		CBehavior wide(p, &bt);
+		s = wide.Tick();
+		assert(s == BH_RUNNING);
+		s = wide.Tick();
+		assert(s == BH_SUCCESS);
+		assert(wide.Get<CParallel>()->GetBehavior(11).GetStatus() == BH_SUCCESS);
+		if (round == 0)
+		{
+			misses = bt.GetTaskPool().GetMisses();
+		}
+	}
+	assert(bt.GetTaskPool().GetMisses() == misses);
+	(void)s;
+	(void)misses;
+
+	// ӽڵ븸ڵ̫Զ,ƫ޷uint16_tʾ
+	CBehaviorAllocate big(0x18000);
+	CMockSequence &sq = big.allocate<CMockSequence>();
+	sq.Initialize(big, 2);
+	big.allocate(0x10000, 1);
+	CMockNode &far = big.allocate<CMockNode>();
+	assert(!sq.IsSpilled());
+	sq.AddChildFront(far);
+	assert(sq.IsSpilled() && sq.GetChildCount() == 3);
+	assert(&sq.GetChild(0) == &far);
+}
+
+// ƽڵ
+// ڵͼչ,һӽڵڸڵ֮,
+// m_Nextָ֮λ,һֵ
+struct SFlatNode
+{
+	uint8_t m_Kind;
+	uint16_t m_ChildCount;
+	uint32_t m_Next;
+	uint32_t m_Param;	// ڵ,ҶӽڵΪҶ±
+};
+
+// ÿڵڵϵ״̬
+struct SFlatState
+{
+	uint32_t m_Current;	// ǰӽڵ±,ظڵΪ
+	uint8_t m_Status;
+};
+
+class CLeafRegistry;
+
+// ƽΪ,ֻ,ɱ
+// ڵBuildӽڵͼ,ҲLoadֱʹӳе
+class CFlatTree
+{
+public:
+	CFlatTree() :
+		m_Nodes(nullptr),
+		m_NodeCount(0)
+	{
+	}
+
+	void Build(CNode &root)
+	{
+		m_Storage.clear();
+		m_Leaves.clear();
+		Append(root);
+		m_Nodes = &m_Storage[0];
+		m_NodeCount = static_cast<uint32_t>(m_Storage.size());
+	}
+
+	// ʹӳеĽڵ,Ҳ޸,ӳڱ֮ǰЧ
+	// ҶӰregistryд,ڵallocate
+	// ӳ汾ʱfalse
+	bool Load(const void *image, size_t size, const CLeafRegistry &registry, CBehaviorAllocate &allocate);
+
+	uint32_t GetNodeCount() const
+	{
+		return m_NodeCount;
+	}
+
+	const SFlatNode &GetNode(uint32_t index) const
+	{
+		return m_Nodes[index];
+	}
+
+	uint32_t GetLeafCount() const
+	{
+		return static_cast<uint32_t>(m_Leaves.size());
+	}
+
+	CNode &GetLeaf(uint32_t index) const
+	{
+		return *m_Leaves[index];
+	}
+
+protected:
+	void Append(CNode &node)
+	{
+		uint32_t index = static_cast<uint32_t>(m_Storage.size());
+		m_Storage.push_back(SFlatNode());
+		m_Storage[index].m_Kind = static_cast<uint8_t>(node.GetKind());
+		m_Storage[index].m_ChildCount = 0;
+		m_Storage[index].m_Param = node.GetParam();
+
+		switch (node.GetKind())
+		{
+		case NODE_LEAF:
+			m_Storage[index].m_Param = GetLeafCount();
+			m_Leaves.push_back(&node);
+			break;
+		case NODE_REPEAT:
+			m_Storage[index].m_ChildCount = 1;
+			Append(static_cast<CDecorator &>(node).GetChild());
+			break;
+		default:
+		{
+			CComposite &composite = static_cast<CComposite &>(node);
+			assert(composite.GetChildCount() > 0);
+			m_Storage[index].m_ChildCount = composite.GetChildCount();
+			for (uint16_t i = 0; i < composite.GetChildCount(); ++i)
+			{
+				Append(composite.GetChild(i));
+			}
+			break;
+		}
+		}
+		m_Storage[index].m_Next = static_cast<uint32_t>(m_Storage.size());
+	}
+
+	// BuildɵĽڵ,LoadʱΪ
+	std::vector<SFlatNode> m_Storage;
+	const SFlatNode *m_Nodes;
+	uint32_t m_NodeCount;
+	std::vector<CNode *> m_Leaves;
+};
+
+// ƽΪڵϵִ
+// ״̬ڵһһӦ,Tickֻ±
+// ҶڹʱҶӽڵһ,֮ظֻ״̬,
+// CBehavior::RestһOnInitialize³ʼ
+class CFlatAgent
+{
+public:
+	CFlatAgent(const CFlatTree &tree) :
+		m_Tree(tree),
+		m_States(tree.GetNodeCount()),
+		m_Tasks(tree.GetLeafCount())
+	{
+		for (size_t i = 0; i < m_States.size(); ++i)
+		{
+			m_States[i].m_Current = 0;
+			m_States[i].m_Status = BH_INVALID;
+		}
+
+		for (uint32_t i = 0; i < tree.GetLeafCount(); ++i)
+		{
+			m_Tasks[i] = tree.GetLeaf(i).Create(nullptr);
+		}
+	}
+
+	~CFlatAgent()
+	{
+		if (IsActive(0))
+		{
+			Abort(0);
+		}
+
+		for (uint32_t i = 0; i < m_Tree.GetLeafCount(); ++i)
+		{
+			m_Tree.GetLeaf(i).Destroy(m_Tasks[i]);
+		}
+	}
+
+	eStatus Tick()
+	{
+		return Tick(0);
+	}
+
+	eStatus GetStatus(uint32_t index = 0) const
+	{
+		return static_cast<eStatus>(m_States[index].m_Status);
+	}
+
+protected:
+	const SFlatNode &Node(uint32_t index) const
+	{
+		return m_Tree.GetNode(index);
+	}
+
+	// л,CBehavior::IsActiveͬ
+	bool IsActive(uint32_t index) const
+	{
+		return m_States[index].m_Status == BH_RUNNING || m_States[index].m_Status == BH_SUSPENDED;
+	}
+
+	eStatus Tick(uint32_t index)
+	{
+		const SFlatNode &node = Node(index);
+		SFlatState &state = m_States[index];
+
+		// ҶӽڵCBehavior::Tickͬ,ֻﻹ
+		if (node.m_Kind == NODE_LEAF)
+		{
+			CTask *task = m_Tasks[node.m_Param];
+			if (!IsActive(index))
+			{
+				task->OnInitialize();
+			}
+
+			eStatus status = task->Update();
+			state.m_Status = static_cast<uint8_t>(status);
+
+			if (!IsActive(index))
+			{
+				task->OnTerminate(status);
+			}
+			return status;
+		}
+
+		if (!IsActive(index))
+		{
+			Initialize(index);
+		}
+
+		eStatus status = Update(index);
+		state.m_Status = static_cast<uint8_t>(status);
+
+		if (!IsActive(index))
+		{
+			Terminate(index);
+		}
+		return status;
+	}
+
+	// ൱CBehavior::Setup/Rest,Ѿ,ֻ״̬
+	void Enter(uint32_t index)
+	{
+		m_States[index].m_Status = BH_INVALID;
+	}
+
+	void Abort(uint32_t index)
+	{
+		const SFlatNode &node = Node(index);
+		if (node.m_Kind == NODE_LEAF)
+		{
+			m_Tasks[node.m_Param]->OnTerminate(BH_ABORTED);
+		}
+		else
+		{
+			AbortChildren(index);
+		}
+		m_States[index].m_Status = BH_ABORTED;
+	}
+
+	void AbortChildren(uint32_t index)
+	{
+		const SFlatNode &node = Node(index);
+		for (uint32_t child = index + 1; child != node.m_Next; child = Node(child).m_Next)
+		{
+			if (IsActive(child))
+			{
+				Abort(child);
+			}
+		}
+	}
+
+	void Initialize(uint32_t index)
+	{
+		const SFlatNode &node = Node(index);
+		SFlatState &state = m_States[index];
+
+		switch (node.m_Kind)
+		{
+		case NODE_SEQUENCE:
+		case NODE_SELECTOR:
+			state.m_Current = index + 1;
+			Enter(state.m_Current);
+			break;
+		case NODE_ACTIVESELECTOR:
+			state.m_Current = node.m_Next;
+			break;
+		case NODE_PARALLEL:
+		case NODE_MONITOR:
+			for (uint32_t child = index + 1; child != node.m_Next; child = Node(child).m_Next)
+			{
+				Enter(child);
+			}
+			break;
+		case NODE_REPEAT:
+			state.m_Current = 0;
+			Enter(index + 1);
+			break;
+		}
+	}
+
+	void Terminate(uint32_t index)
+	{
+		const SFlatNode &node = Node(index);
+		if (node.m_Kind == NODE_PARALLEL || node.m_Kind == NODE_MONITOR)
+		{
+			AbortChildren(index);
+		}
+	}
+
+	eStatus Update(uint32_t index)
+	{
+		const SFlatNode &node = Node(index);
+		SFlatState &state = m_States[index];
+
+		switch (node.m_Kind)
+		{
+		case NODE_SEQUENCE:
+			for (;;)
+			{
+				eStatus s = Tick(state.m_Current);
+				if (s != BH_SUCCESS)
+				{
+					return s;
+				}
+
+				state.m_Current = Node(state.m_Current).m_Next;
+				if (state.m_Current == node.m_Next)
+				{
+					return BH_SUCCESS;
+				}
+				Enter(state.m_Current);
+			}
+		case NODE_SELECTOR:
+			for (;;)
+			{
+				eStatus s = Tick(state.m_Current);
+				if (s != BH_FAILURE)
+				{
+					return s;
+				}
+
+				state.m_Current = Node(state.m_Current).m_Next;
+				if (state.m_Current == node.m_Next)
+				{
+					return BH_FAILURE;
+				}
+				Enter(state.m_Current);
+			}
+		case NODE_ACTIVESELECTOR:
+		{
+			// CActiveSelectorͬ: ǰ֧֮ǰķ֧ÿ½,оͽӹ,
+			// ǰ֧,ʧܺγԺķ֧
+			// CActiveSelectorڰķ֧,ƽûкڰ,ֵ,״̬ͬ
+			uint32_t previous = state.m_Current;
+			eStatus result = BH_FAILURE;
+			for (state.m_Current = index + 1; state.m_Current != node.m_Next; state.m_Current = Node(state.m_Current).m_Next)
+			{
+				if (!IsActive(state.m_Current))
+				{
+					Enter(state.m_Current);
+				}
+
+				result = Tick(state.m_Current);
+				if (result != BH_FAILURE)
+				{
+					break;
+				}
+			}
+
+			// ȼӽڵӹܺ,ϸڵ
+			if (previous != node.m_Next && previous != state.m_Current && IsActive(previous))
+			{
+				Abort(previous);
+			}
+			return CActiveSelector::Poll(result);
+		}
+		case NODE_PARALLEL:
+		case NODE_MONITOR:
+		{
+			// ֵͬ,CMonitorֻδ䡢е
+			CParallel::ePolicy forSuccess = CParallel::RequireOne;
+			CParallel::ePolicy forFailure = CParallel::RequireOne;
+			if (node.m_Kind == NODE_PARALLEL)
+			{
+				forSuccess = static_cast<CParallel::ePolicy>(node.m_Param & 1);
+				forFailure = static_cast<CParallel::ePolicy>((node.m_Param >> 1) & 1);
+			}
+
+			uint16_t nSuccessCount = 0, nFailureCount = 0;
+			for (uint32_t child = index + 1; child != node.m_Next; child = Node(child).m_Next)
+			{
+				eStatus s = static_cast<eStatus>(m_States[child].m_Status);
+				if (s != BH_SUCCESS && s != BH_FAILURE)
+				{
+					s = Tick(child);
+				}
+
+				if (s == BH_SUCCESS)
+				{
+					++nSuccessCount;
+					if (forSuccess == CParallel::RequireOne)
+					{
+						return BH_SUCCESS;
+					}
+				}
+
+				if (s == BH_FAILURE)
+				{
+					++nFailureCount;
+					if (forFailure == CParallel::RequireOne)
+					{
+						return BH_FAILURE;
+					}
+				}
+			}
+
+			if (forFailure == CParallel::RequireAll && nFailureCount == node.m_ChildCount)
+			{
+				return BH_FAILURE;
+			}
+
+			if (forSuccess == CParallel::RequireAll && nSuccessCount == node.m_ChildCount)
+			{
+				return BH_SUCCESS;
+			}
+			return BH_RUNNING;
+		}
+		case NODE_REPEAT:
+			for (;;)
+			{
+				eStatus s = Tick(index + 1);
+				if (IsActive(index + 1)) return s;
+				if (s == BH_FAILURE) return BH_FAILURE;
+				if (++state.m_Current == node.m_Param) return BH_SUCCESS;
+				Enter(index + 1);
+			}
+		}
+
+		assert(false);
+		return BH_INVALID;
+	}
+
+	const CFlatTree &m_Tree;
+	std::vector<SFlatState> m_States;
+	std::vector<CTask *> m_Tasks;
+};
+
+// õȴڵһøǸýڵ
+CNode &buildwaittree(CBehaviorAllocate &t)
+{
+	CMockSequence &root = t.allocate<CMockSequence>();
+	root.Reserve(t, 4);
+	root.AddChild(t.allocate<CWaitNode>(2, BH_SUCCESS));
+
+	CMockSelector &se = t.allocate<CMockSelector>();
+	root.AddChild(se);
+	se.Reserve(t, 2);
+	se.AddChild(t.allocate<CWaitNode>(1, BH_FAILURE));
+	CMockRepeat &re = t.allocate<CMockRepeat>(&t.allocate<CWaitNode>(1, BH_SUCCESS));
+	re.SetParam(3);
+	se.AddChild(re);
+
+	CMockParallel &p = t.allocate<CMockParallel>();
+	root.AddChild(p);
+	p.SetParam(CParallel::MakeParam(CParallel::RequireAll, CParallel::RequireOne));
+	p.Reserve(t, 2);
+	p.AddChild(t.allocate<CWaitNode>(1, BH_SUCCESS));
+	p.AddChild(t.allocate<CWaitNode>(2, BH_SUCCESS));
+
+	root.AddChild(t.allocate<CWaitNode>(0, BH_SUCCESS));
+	return root;
+}
+
+// ʱӴ[m_From, m_To)ʱm_Pass,ʧ
+// ֻȡⲿʱ,ڲѡռ
+struct CClockTask :public CTask
+{
+	CClockTask(CNode &node) :
+		CTask(node)
+	{
+	}
+
+	typedef CClockTask Self;
+	typedef CTask Base;
+
+	virtual eStatus Update();
+};
+
+struct CClockNode :public CNode
+{
+	CClockNode(const int &clock, int from, int to, eStatus pass) :
+		m_Clock(clock),
+		m_From(from),
+		m_To(to),
+		m_Pass(pass)
+	{
+	}
+
+	virtual CTask *Create(CBehaviorTree *bt)
+	{
+		return CreateTask<CClockTask>(*this, bt);
+	}
+
+	virtual void Destroy(CTask *task)
+	{
+		DestroyTask<CClockTask>(task);
+	}
+
+	virtual void Measure(STaskDemand &demand) const
+	{
+		demand.Add<CClockTask>();
+	}
+
+	const int &m_Clock;
+	int m_From;
+	int m_To;
+	eStatus m_Pass;
+};
+
+eStatus CClockTask::Update()
+{
+	CClockNode &node = *static_cast<CClockNode *>(m_Node);
+	return node.m_Clock >= node.m_From && node.m_Clock < node.m_To ? node.m_Pass : BH_FAILURE;
+}
+
+// ͬһֱCBehaviorCFlatAgentִ֡,״̬һ,سɹĴ
+// clockΪʱÿ֡ȸΪ֡Ŷperiodȡģ
+int compareflat(CNode &root, int ticks, int *clock = nullptr, int period = 1)
+{
+	CFlatTree flat;
+	flat.Build(root);
+
+	CBehavior b(root);
+	CFlatAgent agent(flat);
+	int completed = 0;
+	for (int i = 0; i < ticks; ++i)
+	{
+		if (clock != nullptr)
+		{
+			*clock = i % period;
+		}
+
+		eStatus s = b.Tick();
+		eStatus f = agent.Tick();
+		assert(f == s);
+		(void)f;
+		completed += s == BH_SUCCESS;
+	}
+	return completed;
+}
+
+void testflat()
+{
+	CBehaviorAllocate t;
+	CNode &root = buildwaittree(t);
+
+	CFlatTree flat;
+	flat.Build(root);
+	assert(flat.GetNodeCount() == 10 && flat.GetLeafCount() == 6);
+	assert(flat.GetNode(0).m_Next == flat.GetNodeCount());
+
+	int completed = compareflat(root, 30);
+	assert(completed > 1);
+
+	// :ʧʱֹ,Ƚʱֱӷ
+	CMockSelector &se = t.allocate<CMockSelector>();
+	se.Reserve(t, 2);
+	CMockMonitor &interrupted = t.allocate<CMockMonitor>();
+	se.AddChild(interrupted);
+	interrupted.Reserve(t, 2);
+	interrupted.AddChild(t.allocate<CWaitNode>(3, BH_FAILURE));
+	CMockSequence &action = t.allocate<CMockSequence>();
+	interrupted.AddChild(action);
+	action.Reserve(t, 2);
+	action.AddChild(t.allocate<CWaitNode>(1, BH_SUCCESS));
+	action.AddChild(t.allocate<CWaitNode>(4, BH_SUCCESS));
+	CMockMonitor &finished = t.allocate<CMockMonitor>();
+	se.AddChild(finished);
+	finished.Reserve(t, 2);
+	finished.AddChild(t.allocate<CWaitNode>(6, BH_FAILURE));
+	finished.AddChild(t.allocate<CWaitNode>(2, BH_SUCCESS));
+
+	completed = compareflat(se, 40);
+	assert(completed > 1);
+
+	// ѡ:ȼ֧ʱֹȼ֧,صķ֧ʧʱֹ
+	int clock = 0;
+	CMockActiveSelector &as = t.allocate<CMockActiveSelector>();
+	as.Reserve(t, 3);
+	CMockSequence &urgent = t.allocate<CMockSequence>();
+	as.AddChild(urgent);
+	urgent.Reserve(t, 2);
+	urgent.AddChild(t.allocate<CClockNode>(clock, 3, 6, BH_SUCCESS));
+	urgent.AddChild(t.allocate<CWaitNode>(2, BH_SUCCESS));
+	CMockMonitor &guarded = t.allocate<CMockMonitor>();
+	as.AddChild(guarded);
+	guarded.Reserve(t, 2);
+	guarded.AddChild(t.allocate<CClockNode>(clock, 0, 9, BH_RUNNING));
+	CMockRepeat &patrol = t.allocate<CMockRepeat>(&t.allocate<CWaitNode>(2, BH_SUCCESS));
+	patrol.SetParam(2);
+	guarded.AddChild(patrol);
+	as.AddChild(t.allocate<CWaitNode>(1, BH_SUCCESS));
+
+	completed = compareflat(as, 60, &clock, 12);
+	assert(completed > 1);
+	(void)completed;
+}
+
+// Ҷӽڵע
+// ֱҶӽڵĹ,ӳı彨ʱֺͲҶ
+class CLeafRegistry
+{
+public:
+	// paramҶԼ,ȴ֡
+	typedef CNode &(*Factory)(CBehaviorAllocate &allocate, uint32_t param);
+
+	// Ҷڷռõڴ,ĴС
+	struct SLeaf
+	{
+		Factory m_Factory;
+		size_t m_Size;
+		size_t m_Align;
+		bool m_Finalize;
+	};
+
+	// factoryallocate<NODE>ǡһNODE
+	template <class NODE>
+	void Register(const char *name, Factory factory)
+	{
+		static_assert(alignof(NODE) <= alignof(std::max_align_t), "leaf alignment exceeds block alignment");
+		SLeaf leaf = { factory, sizeof(NODE), alignof(NODE), !std::is_trivially_destructible<NODE>::value };
+		m_Leaves[name] = leaf;
+	}
+
+	const SLeaf *FindLeaf(const char *name) const
+	{
+		std::unordered_map<std::string, SLeaf>::const_iterator it = m_Leaves.find(name);
+		return it != m_Leaves.end() ? &it->second : nullptr;
+	}
+
+	Factory Find(const char *name) const
+	{
+		const SLeaf *leaf = FindLeaf(name);
+		return leaf != nullptr ? leaf->m_Factory : nullptr;
+	}
+
+protected:
+	std::unordered_map<std::string, SLeaf> m_Leaves;
+};
+
+// Ϊӳ
+// ƽĽڵֱΪļ,λöӳͷƫ,ûָ
+// ļӳ䵽ڴԭʹ,Ҫ,ӳͬһļʱڴҳ
+// : ļͷ | ڵ | Ҷ | ֱ
+// С˴,ӳʼַ밴4ֽڶ
+struct STreeImageHeader
+{
+	static const uint32_t k_Magic = 0x4D495442;	// "BTIM"
+	static const uint16_t k_Version = 1;
+
+	uint32_t m_Magic;
+	uint16_t m_Version;
+	uint16_t m_HeaderSize;
+	uint32_t m_Size;
+	uint32_t m_NodeOffset;
+	uint32_t m_NodeCount;
+	uint32_t m_LeafOffset;
+	uint32_t m_LeafCount;
+	uint32_t m_NameOffset;
+	uint32_t m_NameSize;
+};
+
+// ӳеҶ,Ϊֱ0βַƫ
+struct STreeImageLeaf
+{
+	uint32_t m_Name;
+	uint32_t m_Param;
+};
+
+// ļʽЩ,޸ʱҪ汾
+static_assert(sizeof(STreeImageHeader) == 36, "tree image header layout changed");
+static_assert(sizeof(SFlatNode) == 12 && offsetof(SFlatNode, m_ChildCount) == 2 && offsetof(SFlatNode, m_Next) == 4, "flat node layout changed");
+static_assert(sizeof(STreeImageLeaf) == 8, "tree image leaf layout changed");
+
+// ӳ
+// ȵ˳,/װνڵBeginʼ,ӽڵ֮End
+class CTreeImageWriter
+{
+public:
+	void Begin(eNodeKind kind, uint32_t param = 0)
+	{
+		assert(kind != NODE_LEAF);
+		m_Open.push_back(Add(kind, param));
+	}
+
+	void End()
+	{
+		assert(!m_Open.empty());
+		uint32_t index = m_Open.back();
+		m_Open.pop_back();
+		assert(m_Nodes[index].m_ChildCount > 0);
+		assert(m_Nodes[index].m_Kind != NODE_REPEAT || m_Nodes[index].m_ChildCount == 1);
+		m_Nodes[index].m_Next = static_cast<uint32_t>(m_Nodes.size());
+	}
+
+	void Leaf(const char *name, uint32_t param = 0)
+	{
+		uint32_t index = Add(NODE_LEAF, static_cast<uint32_t>(m_Leaves.size()));
+		m_Nodes[index].m_Next = index + 1;
+
+		STreeImageLeaf leaf;
+		leaf.m_Name = AddName(name);
+		leaf.m_Param = param;
+		m_Leaves.push_back(leaf);
+	}
+
+	// дӳ,֮¿ʼ
+	void Write(std::vector<char> &image)
+	{
+		assert(m_Open.empty() && !m_Nodes.empty());
+
+		STreeImageHeader header;
+		memset(&header, 0, sizeof(header));
+		header.m_Magic = STreeImageHeader::k_Magic;
+		header.m_Version = STreeImageHeader::k_Version;
+		header.m_HeaderSize = sizeof(STreeImageHeader);
+		header.m_NodeOffset = sizeof(STreeImageHeader);
+		header.m_NodeCount = static_cast<uint32_t>(m_Nodes.size());
+		header.m_LeafOffset = header.m_NodeOffset + header.m_NodeCount * sizeof(SFlatNode);
+		header.m_LeafCount = static_cast<uint32_t>(m_Leaves.size());
+		header.m_NameOffset = header.m_LeafOffset + header.m_LeafCount * sizeof(STreeImageLeaf);
+		header.m_NameSize = static_cast<uint32_t>(m_Names.size());
+		header.m_Size = header.m_NameOffset + header.m_NameSize;
+
+		image.resize(header.m_Size);
+		memcpy(&image[0], &header, sizeof(header));
+		memcpy(&image[header.m_NodeOffset], &m_Nodes[0], m_Nodes.size() * sizeof(SFlatNode));
+		if (!m_Leaves.empty())
+		{
+			memcpy(&image[header.m_LeafOffset], &m_Leaves[0], m_Leaves.size() * sizeof(STreeImageLeaf));
+		}
+		if (!m_Names.empty())
+		{
+			memcpy(&image[header.m_NameOffset], &m_Names[0], m_Names.size());
+		}
+
+		m_Nodes.clear();
+		m_Leaves.clear();
+		m_Names.clear();
+		m_NameOffsets.clear();
+	}
+
+protected:
+	uint32_t Add(eNodeKind kind, uint32_t param)
+	{
+		if (!m_Open.empty())
+		{
+			++m_Nodes[m_Open.back()].m_ChildCount;
+		}
+
+		// ֽҲ,ͬǵõͬӳ
+		SFlatNode node;
+		memset(&node, 0, sizeof(node));
+		node.m_Kind = static_cast<uint8_t>(kind);
+		node.m_Param = param;
+		m_Nodes.push_back(node);
+		return static_cast<uint32_t>(m_Nodes.size() - 1);
+	}
+
+	// ֻͬһ
+	uint32_t AddName(const char *name)
+	{
+		std::unordered_map<std::string, uint32_t>::iterator it = m_NameOffsets.find(name);
+		if (it != m_NameOffsets.end())
+		{
+			return it->second;
+		}
+
+		uint32_t offset = static_cast<uint32_t>(m_Names.size());
+		m_Names.insert(m_Names.end(), name, name + strlen(name) + 1);
+		m_NameOffsets[name] = offset;
+		return offset;
+	}
+
+	std::vector<SFlatNode> m_Nodes;
+	std::vector<uint32_t> m_Open;
+	std::vector<STreeImageLeaf> m_Leaves;
+	std::vector<char> m_Names;
+	std::unordered_map<std::string, uint32_t> m_NameOffsets;
+};
+
+// ֻӳ,ƫƺ±궼ڷΧ,ȷǶ,0β
+bool ValidateTreeImage(const void *image, size_t size)
+{
+	if (image == nullptr || reinterpret_cast<uintptr_t>(image) % alignof(STreeImageHeader) != 0 || size < sizeof(STreeImageHeader))
+	{
+		return false;
+	}
+
+	const char *base = static_cast<const char *>(image);
+	const STreeImageHeader &header = *static_cast<const STreeImageHeader *>(image);
+	if (header.m_Magic != STreeImageHeader::k_Magic || header.m_Version != STreeImageHeader::k_Version ||
+		header.m_HeaderSize != sizeof(STreeImageHeader) || header.m_Size > size || header.m_NodeCount == 0)
+	{
+		return false;
+	}
+
+	// ,64λ
+	uint64_t nodeEnd = uint64_t(header.m_NodeOffset) + uint64_t(header.m_NodeCount) * sizeof(SFlatNode);
+	uint64_t leafEnd = uint64_t(header.m_LeafOffset) + uint64_t(header.m_LeafCount) * sizeof(STreeImageLeaf);
+	uint64_t nameEnd = uint64_t(header.m_NameOffset) + header.m_NameSize;
+	if (header.m_NodeOffset < sizeof(STreeImageHeader) || header.m_NodeOffset % alignof(SFlatNode) != 0 ||
+		header.m_LeafOffset < nodeEnd || header.m_LeafOffset % alignof(STreeImageLeaf) != 0 ||
+		header.m_NameOffset < leafEnd || nameEnd > header.m_Size)
+	{
+		return false;
+	}
+
+	const SFlatNode *nodes = reinterpret_cast<const SFlatNode *>(base + header.m_NodeOffset);
+	if (nodes[0].m_Next != header.m_NodeCount)
+	{
+		return false;
+	}
+
+	uint32_t leaves = 0;
+	for (uint32_t i = 0; i < header.m_NodeCount; ++i)
+	{
+		const SFlatNode &node = nodes[i];
+		if (node.m_Kind > NODE_REPEAT || node.m_Next <= i || node.m_Next > header.m_NodeCount)
+		{
+			return false;
+		}
+
+		if (node.m_Kind == NODE_LEAF)
+		{
+			if (node.m_Next != i + 1 || node.m_ChildCount != 0 || node.m_Param != leaves++)
+			{
+				return false;
+			}
+			continue;
+		}
+
+		// ӽڵβ,ǡڵ
+		uint32_t child = i + 1;
+		uint16_t count = 0;
+		while (child < node.m_Next && count < node.m_ChildCount)
+		{
+			child = nodes[child].m_Next;
+			++count;
+		}
+		if (count == 0 || count != node.m_ChildCount || child != node.m_Next || (node.m_Kind == NODE_REPEAT && count != 1))
+		{
+			return false;
+		}
+
+		// ظ0εĽڵԶ
+		if (node.m_Kind == NODE_REPEAT && node.m_Param == 0)
+		{
+			return false;
+		}
+	}
+
+	if (leaves != header.m_LeafCount)
+	{
+		return false;
+	}
+
+	const STreeImageLeaf *leafTable = reinterpret_cast<const STreeImageLeaf *>(base + header.m_LeafOffset);
+	const char *names = base + header.m_NameOffset;
+	for (uint32_t i = 0; i < header.m_LeafCount; ++i)
+	{
+		uint32_t name = leafTable[i].m_Name;
+		if (name >= header.m_NameSize || memchr(names + name, 0, header.m_NameSize - name) == nullptr)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool CFlatTree::Load(const void *image, size_t size, const CLeafRegistry &registry, CBehaviorAllocate &allocate)
+{
+	m_Storage.clear();
+	m_Leaves.clear();
+	m_Nodes = nullptr;
+	m_NodeCount = 0;
+
+	if (!ValidateTreeImage(image, size))
+	{
+		return false;
+	}
+
+	const char *base = static_cast<const char *>(image);
+	const STreeImageHeader &header = *static_cast<const STreeImageHeader *>(image);
+	const STreeImageLeaf *leaves = reinterpret_cast<const STreeImageLeaf *>(base + header.m_LeafOffset);
+	const char *names = base + header.m_NameOffset;
+
+	// Ҷӽڵ㺬麯,ֻڱд
+	m_Leaves.reserve(header.m_LeafCount);
+	for (uint32_t i = 0; i < header.m_LeafCount; ++i)
+	{
+		CLeafRegistry::Factory factory = registry.Find(names + leaves[i].m_Name);
+		if (factory == nullptr)
+		{
+			m_Leaves.clear();
+			return false;
+		}
+		m_Leaves.push_back(&factory(allocate, leaves[i].m_Param));
+	}
+
+	m_Nodes = reinterpret_cast<const SFlatNode *>(base + header.m_NodeOffset);
+	m_NodeCount = header.m_NodeCount;
+	return true;
+}
+
+// ȴڵĲ,16λΪ֡,λΪ
+CNode &createwaitleaf(CBehaviorAllocate &allocate, uint32_t param)
+{
+	return allocate.allocate<CWaitNode>(param & 0xFFFF, static_cast<eStatus>(param >> 16));
+}
+
+uint32_t waitparam(uint32_t ticks, eStatus result)
+{
+	return ticks | (static_cast<uint32_t>(result) << 16);
+}
+
+// buildwaittreeͬ
+void writewaitimage(std::vector<char> &image)
+{
+	CTreeImageWriter w;
+	w.Begin(NODE_SEQUENCE);
+	w.Leaf("wait", waitparam(2, BH_SUCCESS));
+	w.Begin(NODE_SELECTOR);
+	w.Leaf("wait", waitparam(1, BH_FAILURE));
+	w.Begin(NODE_REPEAT, 3);
+	w.Leaf("wait", waitparam(1, BH_SUCCESS));
+	w.End();
+	w.End();
+	w.Begin(NODE_PARALLEL, CParallel::MakeParam(CParallel::RequireAll, CParallel::RequireOne));
+	w.Leaf("wait", waitparam(1, BH_SUCCESS));
+	w.Leaf("wait", waitparam(2, BH_SUCCESS));
+	w.End();
+	w.Leaf("wait", waitparam(0, BH_SUCCESS));
+	w.End();
+	w.Write(image);
+}
+
+void testtreeimage()
+{
+	CLeafRegistry registry;
+	registry.Register<CWaitNode>("wait", &createwaitleaf);
+
+	std::vector<char> image;
+	writewaitimage(image);
+
+	// ڵӽڵͼƽĽͬ
+	CBehaviorAllocate t;
+	CFlatTree built;
+	built.Build(buildwaittree(t));
+
+	// vector<uint32_t>֤,൱ӳļ
+	std::vector<uint32_t> mapped((image.size() + 3) / 4);
+	memcpy(&mapped[0], &image[0], image.size());
+
+	CBehaviorAllocate leaves;
+	CFlatTree loaded;
+	bool ok = loaded.Load(&mapped[0], image.size(), registry, leaves);
+	assert(ok);
+	assert(loaded.GetNodeCount() == built.GetNodeCount() && loaded.GetLeafCount() == built.GetLeafCount());
+	for (uint32_t i = 0; i < loaded.GetNodeCount(); ++i)
+	{
+		assert(loaded.GetNode(i).m_Kind == built.GetNode(i).m_Kind);
+		assert(loaded.GetNode(i).m_Next == built.GetNode(i).m_Next);
+		assert(loaded.GetNode(i).m_ChildCount == built.GetNode(i).m_ChildCount);
+		assert(loaded.GetNode(i).m_Param == built.GetNode(i).m_Param);
+	}
+
+	// ԭʹ,ڵӳ
+	const char *base = reinterpret_cast<const char *>(&mapped[0]);
+	(void)base;
+	assert(reinterpret_cast<const char *>(&loaded.GetNode(0)) >= base && reinterpret_cast<const char *>(&loaded.GetNode(0)) < base + image.size());
+
+	CFlatAgent a(built), b(loaded);
+	for (int i = 0; i < 30; ++i)
+	{
+		eStatus s = a.Tick();
+		eStatus f = b.Tick();
+		assert(f == s);
+		(void)s;
+		(void)f;
+	}
+
+	// 𻵻ʶӳ񲻱
+	CFlatTree bad;
+	ok = bad.Load(&mapped[0], image.size() - 1, registry, leaves);
+	assert(!ok);
+	mapped[0] ^= 1;
+	ok = bad.Load(&mapped[0], image.size(), registry, leaves);
+	assert(!ok);
+	mapped[0] ^= 1;
+	reinterpret_cast<STreeImageHeader *>(&mapped[0])->m_Version = STreeImageHeader::k_Version + 1;
+	ok = bad.Load(&mapped[0], image.size(), registry, leaves);
+	assert(!ok);
+	reinterpret_cast<STreeImageHeader *>(&mapped[0])->m_Version = STreeImageHeader::k_Version;
+	for (uint32_t i = 0; i < loaded.GetNodeCount(); ++i)
+	{
+		SFlatNode &node = const_cast<SFlatNode &>(loaded.GetNode(i));
+		if (node.m_Kind == NODE_REPEAT)
+		{
+			uint32_t param = node.m_Param;
+			node.m_Param = 0;
+			ok = ValidateTreeImage(&mapped[0], image.size());
+			assert(!ok);
+			node.m_Param = param;
+			ok = ValidateTreeImage(&mapped[0], image.size());
+			assert(ok);
+		}
+	}
+	const_cast<SFlatNode &>(loaded.GetNode(1)).m_Next = 7;
+	ok = ValidateTreeImage(&mapped[0], image.size());
+	assert(!ok);
+
+	CLeafRegistry empty;
+	writewaitimage(image);
+	memcpy(&mapped[0], &image[0], image.size());
+	ok = bad.Load(&mapped[0], image.size(), empty, leaves);
+	assert(!ok);
+	ok = bad.Load(&mapped[0], image.size(), registry, leaves);
+	assert(ok);
+	(void)ok;
+}
+
+// ÿӽڵͼƽ,ӳصĺʱ
+void benchtreeimage()
+{
+	const int k_Trees = 10000;
+	CLeafRegistry registry;
+	registry.Register<CWaitNode>("wait", &createwaitleaf);
+
+	std::vector<char> bytes;
+	writewaitimage(bytes);
+	std::vector<uint32_t> image((bytes.size() + 3) / 4);
+	memcpy(&image[0], &bytes[0], bytes.size());
+
+	CBehaviorAllocate allocate;
+	std::vector<CFlatTree> trees(k_Trees);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < k_Trees; ++i)
+	{
+		trees[i].Build(buildwaittree(allocate));
+	}
+	double build = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+	allocate.reset();
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < k_Trees; ++i)
+	{
+		trees[i].Load(&image[0], bytes.size(), registry, allocate);
+	}
+	double load = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+	printf("treeimage trees=%d build=%.0fus load=%.0fus bytes=%d\n", k_Trees, build, load, static_cast<int>(bytes.size()));
+}
+
+// ı
+// ÿڵд [()] [{ ӽڵ... }],հ׷ָ,#βΪע
+//   sequence/selector/activeselector/monitor { ӽڵ... }
+//   parallel(one|all, one|all) { ӽڵ... }	ɹʧܵĲ,Ĭ϶Ϊone
+//   repeat() { ӽڵ }
+// ΪעҶ,ɴһ,
+//   selector { sequence { enemy attack } repeat(3) { wait(2) } }
+// ȽɱƽĽڵ鲢,ͬʱڵͼڷеȷдС,һ,˳
+class CTreeParser
+{
+public:
+	CTreeParser(const CLeafRegistry &registry) :
+		m_Registry(registry)
+	{
+	}
+
+	// ,ʧʱGetErrorкźԭ
+	bool Parse(const char *text, size_t length)
+	{
+		m_Nodes.clear();
+		m_Leaves.clear();
+		m_Error.clear();
+		m_Text = text;
+		m_End = text + length;
+		m_Line = 1;
+
+		if (!ParseNode(0))
+		{
+			return false;
+		}
+
+		SkipSpace();
+		if (m_Text != m_End)
+		{
+			return Fail("unexpected text after root");
+		}
+
+		m_Size = 0;
+		Layout(0);
+		return true;
+	}
+
+	// Ҫֽ,Buildʵõһ
+	size_t GetSize() const
+	{
+		return m_Size;
+	}
+
+	const std::string &GetError() const
+	{
+		return m_Error;
+	}
+
+	// ĽʱĲ,CTreeDefinitionԭ
+	bool SetError(const char *reason)
+	{
+		m_Error = reason;
+		return false;
+	}
+
+	// Ľ,˳Layoutͬ
+	CNode &Build(CBehaviorAllocate &allocate) const
+	{
+		return Build(allocate, 0);
+	}
+
+protected:
+	static const uint32_t k_MaxDepth = 256;
+
+	struct SLeaf
+	{
+		const CLeafRegistry::SLeaf *m_Leaf;
+		uint32_t m_Param;
+	};
+
+	bool Fail(const char *reason)
+	{
+		char line[32];
+		snprintf(line, sizeof(line), "line %d: ", m_Line);
+		m_Error = line;
+		m_Error += reason;
+		return false;
+	}
+
+	void SkipSpace()
+	{
+		while (m_Text != m_End)
+		{
+			if (*m_Text == '#')
+			{
+				while (m_Text != m_End && *m_Text != '\n')
+				{
+					++m_Text;
+				}
+			}
+			else if (*m_Text == ' ' || *m_Text == '\t' || *m_Text == '\r' || *m_Text == '\n')
+			{
+				m_Line += *m_Text == '\n';
+				++m_Text;
+			}
+			else
+			{
+				break;
+			}
+		}
+	}
+
+	bool Accept(char c)
+	{
+		SkipSpace();
+		if (m_Text != m_End && *m_Text == c)
+		{
+			++m_Text;
+			return true;
+		}
+		return false;
+	}
+
+	static bool IsNameChar(char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.';
+	}
+
+	// ֲ,س
+	size_t ReadName(const char *&name)
+	{
+		SkipSpace();
+		name = m_Text;
+		while (m_Text != m_End && IsNameChar(*m_Text))
+		{
+			++m_Text;
+		}
+		return static_cast<size_t>(m_Text - name);
+	}
+
+	static bool Equals(const char *name, size_t length, const char *keyword)
+	{
+		return strlen(keyword) == length && memcmp(name, keyword, length) == 0;
+	}
+
+	bool ReadNumber(uint32_t &value)
+	{
+		SkipSpace();
+		if (m_Text == m_End || *m_Text < '0' || *m_Text > '9')
+		{
+			return Fail("expected number");
+		}
+
+		uint64_t result = 0;
+		while (m_Text != m_End && *m_Text >= '0' && *m_Text <= '9')
+		{
+			result = result * 10 + (*m_Text++ - '0');
+			if (result > std::numeric_limits<uint32_t>::max())
+			{
+				return Fail("number out of range");
+			}
+		}
+		value = static_cast<uint32_t>(result);
+		return true;
+	}
+
+	bool ReadPolicy(CParallel::ePolicy &policy)
+	{
+		const char *name;
+		size_t length = ReadName(name);
+		if (Equals(name, length, "one"))
+		{
+			policy = CParallel::RequireOne;
+		}
+		else if (Equals(name, length, "all"))
+		{
+			policy = CParallel::RequireAll;
+		}
+		else
+		{
+			return Fail("expected one or all");
+		}
+		return true;
+	}
+
+	bool ParseParam(eNodeKind kind, uint32_t &param)
+	{
+		param = kind == NODE_PARALLEL ? CParallel::MakeParam(CParallel::RequireOne, CParallel::RequireOne) : 0;
+		if (!Accept('('))
+		{
+			if (kind == NODE_REPEAT)
+			{
+				return Fail("repeat needs a count");
+			}
+			return true;
+		}
+
+		switch (kind)
+		{
+		case NODE_PARALLEL:
+		{
+			CParallel::ePolicy forSuccess, forFailure;
+			if (!ReadPolicy(forSuccess))
+			{
+				return false;
+			}
+			if (!Accept(','))
+			{
+				return Fail("expected ,");
+			}
+			if (!ReadPolicy(forFailure))
+			{
+				return false;
+			}
+			param = CParallel::MakeParam(forSuccess, forFailure);
+			break;
+		}
+		case NODE_REPEAT:
+		case NODE_LEAF:
+			if (!ReadNumber(param))
+			{
+				return false;
+			}
+			if (kind == NODE_REPEAT && param == 0)
+			{
+				return Fail("repeat count must be positive");
+			}
+			break;
+		default:
+			return Fail("node takes no parameters");
+		}
+
+		return Accept(')') || Fail("expected )");
+	}
+
+	// ,Сͽݹ,Ƕдıűջ
+	bool ParseNode(uint32_t depth)
+	{
+		if (depth == k_MaxDepth)
+		{
+			return Fail("nesting too deep");
+		}
+
+		const char *name;
+		size_t length = ReadName(name);
+		if (length == 0)
+		{
+			return Fail("expected node name");
+		}
+
+		eNodeKind kind = NODE_LEAF;
+		static const struct
+		{
+			const char *m_Name;
+			eNodeKind m_Kind;
+		} k_Keywords[] =
+		{
+			{ "sequence", NODE_SEQUENCE },
+			{ "selector", NODE_SELECTOR },
+			{ "parallel", NODE_PARALLEL },
+			{ "monitor", NODE_MONITOR },
+			{ "activeselector", NODE_ACTIVESELECTOR },
+			{ "repeat", NODE_REPEAT },
+		};
+		for (size_t i = 0; i < sizeof(k_Keywords) / sizeof(k_Keywords[0]); ++i)
+		{
+			if (Equals(name, length, k_Keywords[i].m_Name))
+			{
+				kind = k_Keywords[i].m_Kind;
+			}
+		}
+
+		uint32_t index = static_cast<uint32_t>(m_Nodes.size());
+		SFlatNode node;
+		memset(&node, 0, sizeof(node));
+		node.m_Kind = static_cast<uint8_t>(kind);
+
+		if (kind == NODE_LEAF)
+		{
+			SLeaf leaf;
+			leaf.m_Leaf = m_Registry.FindLeaf(std::string(name, length).c_str());
+			if (leaf.m_Leaf == nullptr)
+			{
+				return Fail(("unknown leaf " + std::string(name, length)).c_str());
+			}
+			if (!ParseParam(kind, leaf.m_Param))
+			{
+				return false;
+			}
+			if (Accept('{'))
+			{
+				return Fail("leaf cannot have children");
+			}
+
+			node.m_Param = static_cast<uint32_t>(m_Leaves.size());
+			node.m_Next = index + 1;
+			m_Leaves.push_back(leaf);
+			m_Nodes.push_back(node);
+			return true;
+		}
+
+		if (!ParseParam(kind, node.m_Param))
+		{
+			return false;
+		}
+		m_Nodes.push_back(node);
+
+		if (!Accept('{'))
+		{
+			return Fail("expected {");
+		}
+
+		uint32_t count = 0;
+		while (!Accept('}'))
+		{
+			if (m_Text == m_End)
+			{
+				return Fail("expected }");
+			}
+			if (count == std::numeric_limits<uint16_t>::max())
+			{
+				return Fail("too many children");
+			}
+			if (!ParseNode(depth + 1))
+			{
+				return false;
+			}
+			++count;
+		}
+
+		if (count == 0 || (kind == NODE_REPEAT && count != 1))
+		{
+			return Fail(kind == NODE_REPEAT ? "repeat needs exactly one child" : "composite needs children");
+		}
+
+		m_Nodes[index].m_ChildCount = static_cast<uint16_t>(count);
+		m_Nodes[index].m_Next = static_cast<uint32_t>(m_Nodes.size());
+		return true;
+	}
+
+	// CBehaviorAllocate::allocateĶ뷽ʽͬ
+	// ʼַmax_align_t,͵Ķ붼,ֻƫƼ㼴
+	void Take(size_t size, size_t align)
+	{
+		m_Size = (m_Size + align - 1) & ~(align - 1);
+		m_Size += size;
+	}
+
+	// ضƫ
+	template <class T>
+	size_t Take()
+	{
+		if (!std::is_trivially_destructible<T>::value)
+		{
+			Take(CBehaviorAllocate::finalizer_size(), CBehaviorAllocate::finalizer_align());
+		}
+		Take(sizeof(T), alignof(T));
+		return m_Size - sizeof(T);
+	}
+
+	template <class T>
+	size_t LayoutComposite(uint32_t index)
+	{
+		const SFlatNode &node = m_Nodes[index];
+		size_t self = Take<T>();
+
+		// CComposite::ReserveMakeRoomתƫͬ
+		size_t capacity = 0;
+		if (node.m_ChildCount > k_MaxChildrenPerComposite)
+		{
+			capacity = node.m_ChildCount;
+			Take(sizeof(int32_t) * capacity, alignof(int32_t));
+		}
+
+		uint16_t added = 0;
+		for (uint32_t child = index + 1; child != node.m_Next; child = m_Nodes[child].m_Next)
+		{
+			size_t offset = Layout(child);
+			if (capacity != 0)
+			{
+				if (added == capacity)
+				{
+					capacity *= 2;
+					Take(sizeof(int32_t) * capacity, alignof(int32_t));
+				}
+			}
+			else if (added == k_MaxChildrenPerComposite || offset <= self || offset - self >= std::numeric_limits<uint16_t>::max())
+			{
+				capacity = k_MaxChildrenPerComposite * 2;
+				Take(sizeof(int32_t) * capacity, alignof(int32_t));
+			}
+			++added;
+		}
+		return self;
+	}
+
+	// Buildķ˳ۼƴС,ؽڵƫ
+	size_t Layout(uint32_t index)
+	{
+		const SFlatNode &node = m_Nodes[index];
+		switch (node.m_Kind)
+		{
+		case NODE_LEAF:
+		{
+			const CLeafRegistry::SLeaf &leaf = *m_Leaves[node.m_Param].m_Leaf;
+			if (leaf.m_Finalize)
+			{
+				Take(CBehaviorAllocate::finalizer_size(), CBehaviorAllocate::finalizer_align());
+			}
+			Take(leaf.m_Size, leaf.m_Align);
+			return m_Size - leaf.m_Size;
+		}
+		case NODE_REPEAT:
+			// װνڵ㹹ʱҪӽڵ,ӽڵȷ
+			Layout(index + 1);
+			return Take<CMockRepeat>();
+		case NODE_SEQUENCE:
+			return LayoutComposite<CMockSequence>(index);
+		case NODE_SELECTOR:
+			return LayoutComposite<CMockSelector>(index);
+		case NODE_PARALLEL:
+			return LayoutComposite<CMockParallel>(index);
+		case NODE_MONITOR:
+			return LayoutComposite<CMockMonitor>(index);
+		default:
+			assert(node.m_Kind == NODE_ACTIVESELECTOR);
+			return LayoutComposite<CMockActiveSelector>(index);
+		}
+	}
+
+	template <class T>
+	CNode &BuildComposite(CBehaviorAllocate &allocate, uint32_t index) const
+	{
+		const SFlatNode &node = m_Nodes[index];
+		T &composite = allocate.allocate<T>();
+		composite.SetParam(node.m_Param);
+		composite.Reserve(allocate, node.m_ChildCount);
+		for (uint32_t child = index + 1; child != node.m_Next; child = m_Nodes[child].m_Next)
+		{
+			composite.AddChild(Build(allocate, child));
+		}
+		return composite;
+	}
+
+	CNode &Build(CBehaviorAllocate &allocate, uint32_t index) const
+	{
+		const SFlatNode &node = m_Nodes[index];
+		switch (node.m_Kind)
+		{
+		case NODE_LEAF:
+		{
+			const SLeaf &leaf = m_Leaves[node.m_Param];
+			return leaf.m_Leaf->m_Factory(allocate, leaf.m_Param);
+		}
+		case NODE_REPEAT:
+		{
+			CNode &child = Build(allocate, index + 1);
+			CMockRepeat &repeat = allocate.allocate<CMockRepeat>(&child);
+			repeat.SetParam(node.m_Param);
+			return repeat;
+		}
+		case NODE_SEQUENCE:
+			return BuildComposite<CMockSequence>(allocate, index);
+		case NODE_SELECTOR:
+			return BuildComposite<CMockSelector>(allocate, index);
+		case NODE_PARALLEL:
+			return BuildComposite<CMockParallel>(allocate, index);
+		case NODE_MONITOR:
+			return BuildComposite<CMockMonitor>(allocate, index);
+		default:
+			assert(node.m_Kind == NODE_ACTIVESELECTOR);
+			return BuildComposite<CMockActiveSelector>(allocate, index);
+		}
+	}
+
+	const CLeafRegistry &m_Registry;
+	std::vector<SFlatNode> m_Nodes;
+	std::vector<SLeaf> m_Leaves;
+	std::string m_Error;
+	const char *m_Text;
+	const char *m_End;
+	int m_Line;
+	size_t m_Size;
+};
+
+// ıصΪ,ڵͼһڴ
+class CTreeDefinition
+{
+public:
+	CTreeDefinition() :
+		m_Root(nullptr)
+	{
+	}
+
+	// Ըͬһparser,ʧʱϢparser
+	bool Load(CTreeParser &parser, const char *text, size_t length)
+	{
+		if (!parser.Parse(text, length))
+		{
+			return false;
+		}
+
+		m_Allocate.reset();
+		m_Allocate.reserve(parser.GetSize());
+		m_Root = &parser.Build(m_Allocate);
+
+		// ҶӹǼǵĲʱ,СԲ,ڵͼҲԤһڴ
+		if (m_Allocate.size() != parser.GetSize())
+		{
+			m_Allocate.reset();
+			m_Root = nullptr;
+			return parser.SetError("leaf factory does not match its registered type");
+		}
+		return true;
+	}
+
+	CNode *GetRoot() const
+	{
+		return m_Root;
+	}
+
+	// ڵͼռõֽ
+	size_t GetSize() const
+	{
+		return m_Allocate.size();
+	}
+
+	size_t GetCapacity() const
+	{
+		return m_Allocate.capacity();
+	}
+
+protected:
+	CBehaviorAllocate m_Allocate;
+	CNode *m_Root;
+};
+
+// threads̼߳countݶ,registryڼڼֻ,Թ
+// ÿ߳Լparser,ԭ±ȡһ,
+// ʧܵĸ
+size_t LoadTreeDefinitions(const CLeafRegistry &registry, const std::string *texts, CTreeDefinition *definitions, size_t count, unsigned threads)
+{
+	std::atomic<size_t> next(0);
+	std::atomic<size_t> failed(0);
+	auto worker = [&]()
+	{
+		CTreeParser parser(registry);
+		for (size_t i = next++; i < count; i = next++)
+		{
+			if (!definitions[i].Load(parser, texts[i].data(), texts[i].size()))
+			{
+				++failed;
+			}
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned i = 1; i < threads; ++i)
+	{
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (size_t i = 0; i < pool.size(); ++i)
+	{
+		pool[i].join();
+	}
+	return failed;
+}
+
+// buildwaittreeͬ,ҶwaitĲΪ֡
+const char *k_WaitTreeText =
+	"# buildwaittree\n"
+	"sequence {\n"
+	"	wait(2)\n"
+	"	selector { fail(1) repeat(3) { wait(1) } }\n"
+	"	parallel(all, one) { wait(1) wait(2) }\n"
+	"	wait\n"
+	"}\n";
+
+void registerwaitleaves(CLeafRegistry &registry)
+{
+	registry.Register<CWaitNode>("wait", [](CBehaviorAllocate &allocate, uint32_t param) -> CNode &
+	{
+		return allocate.allocate<CWaitNode>(param, BH_SUCCESS);
+	});
+	registry.Register<CWaitNode>("fail", [](CBehaviorAllocate &allocate, uint32_t param) -> CNode &
+	{
+		return allocate.allocate<CWaitNode>(param, BH_FAILURE);
+	});
+}
+
+void testtreeparser()
+{
+	CLeafRegistry registry;
+	registerwaitleaves(registry);
+	CTreeParser parser(registry);
+
+	// ִнͬ,ֻһǡùõڴ
+	CTreeDefinition definition;
+	bool ok = definition.Load(parser, k_WaitTreeText, strlen(k_WaitTreeText));
+	assert(ok);
+	assert(definition.GetSize() == parser.GetSize() && definition.GetCapacity() == parser.GetSize());
+
+	CBehaviorAllocate t;
+	CBehavior a(buildwaittree(t));
+	CBehavior b(*definition.GetRoot());
+	for (int i = 0; i < 30; ++i)
+	{
+		eStatus s = a.Tick();
+		eStatus f = b.Tick();
+		assert(f == s);
+		(void)s;
+		(void)f;
+	}
+
+	// ӽڵʱתƫҲ
+	std::string wide = "parallel(all, all) {";
+	for (int i = 0; i < 20; ++i)
+	{
+		wide += " wait(1)";
+	}
+	wide += " repeat(2) { selector { fail fail wait(3) } } }";
+	CTreeDefinition w;
+	ok = w.Load(parser, wide.data(), wide.size());
+	assert(ok);
+	assert(w.GetCapacity() == parser.GetSize());
+	assert(static_cast<CComposite *>(w.GetRoot())->GetChildCount() == 21);
+
+	// 
+	const char *bad[] =
+	{
+		"",
+		"sequence { }",
+		"sequence { wait",
+		"repeat { wait }",
+		"repeat(0) { wait }",
+		"repeat(2) { wait wait }",
+		"parallel(one) { wait }",
+		"selector { unknown }",
+		"wait { wait }",
+		"sequence(1) { wait }",
+		"wait(99999999999)",
+		"wait wait",
+	};
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i)
+	{
+		ok = parser.Parse(bad[i], strlen(bad[i]));
+		assert(!ok && !parser.GetError().empty());
+	}
+	ok = parser.Parse("sequence {\n wait\n nothing }", 27);
+	assert(!ok && parser.GetError() == "line 3: unknown leaf nothing");
+	ok = parser.Parse("repeat(0) { wait }", 18);
+	assert(!ok && parser.GetError() == "line 1: repeat count must be positive");
+
+	// Ƕ׹
+	std::string deep;
+	for (int i = 0; i < 300; ++i)
+	{
+		deep += "sequence { ";
+	}
+	ok = parser.Parse(deep.data(), deep.size());
+	assert(!ok && parser.GetError() == "line 1: nesting too deep");
+
+	// ǼǵĲʱʧ,½ڵͼ
+	CLeafRegistry mismatched;
+	mismatched.Register<CWaitNode>("wait", [](CBehaviorAllocate &allocate, uint32_t) -> CNode &
+	{
+		return allocate.allocate<CMockNode>();
+	});
+	CTreeParser other(mismatched);
+	CTreeDefinition m;
+	ok = m.Load(other, "sequence { wait wait }", 22);
+	assert(!ok && m.GetRoot() == nullptr && other.GetError() == "leaf factory does not match its registered type");
+
+	// ̼߳
+	const size_t k_Count = 200;
+	std::vector<std::string> texts(k_Count, k_WaitTreeText);
+	texts[7] = "selector { broken";
+	std::vector<CTreeDefinition> definitions(k_Count);
+	size_t failed = LoadTreeDefinitions(registry, &texts[0], &definitions[0], k_Count, 4);
+	assert(failed == 1);
+	assert(definitions[7].GetRoot() == nullptr && definitions[8].GetRoot() != nullptr);
+	(void)failed;
+	(void)ok;
+}
+
+// ضĺʱ,̺߳Ͷ߳
+void benchtreeparser()
+{
+	const size_t k_Count = 20000;
+	CLeafRegistry registry;
+	registerwaitleaves(registry);
+	std::vector<std::string> texts(k_Count, k_WaitTreeText);
+
+	unsigned hardware = std::thread::hardware_concurrency();
+	unsigned counts[] = { 1, hardware > 1 ? hardware : 2 };
+	for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+	{
+		std::vector<CTreeDefinition> definitions(k_Count);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		LoadTreeDefinitions(registry, &texts[0], &definitions[0], k_Count, counts[i]);
+		double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		printf("treeparser definitions=%d threads=%u %.0fus %.2fus/definition\n", static_cast<int>(k_Count), counts[i], us, us / k_Count);
+	}
+}
+
+// Ϊһ汾,ڼ
+class CTreeVersion
+{
+public:
+	CTreeVersion(uint32_t version) :
+		m_Version(version),
+		m_Refs(1)
+	{
+	}
+
+	CTreeDefinition &GetDefinition()
+	{
+		return m_Definition;
+	}
+
+	CNode &GetRoot() const
+	{
+		return *m_Definition.GetRoot();
+	}
+
+	// ڼη,1ʼ
+	uint32_t GetVersion() const
+	{
+		return m_Version;
+	}
+
+	uint32_t GetRefs() const
+	{
+		return m_Refs.load(std::memory_order_acquire);
+	}
+
+	void Release()
+	{
+		m_Refs.fetch_sub(1, std::memory_order_release);
+	}
+
+protected:
+	friend class CTreeSlot;
+	friend class CTreeLibrary;
+
+	CTreeDefinition m_Definition;
+	uint32_t m_Version;
+	std::atomic<uint32_t> m_Refs;
+};
+
+// һֶӦĵǰ汾
+// ȡǰ汾ֻһԭӶһԭӼ,,Tickе
+class CTreeSlot
+{
+public:
+	CTreeSlot() :
+		m_Current(nullptr)
+	{
+	}
+
+	// ,ֻȽ
+	const CTreeVersion *Peek() const
+	{
+		return m_Current.load(std::memory_order_acquire);
+	}
+
+	// ,Release
+	CTreeVersion *Acquire()
+	{
+		CTreeVersion *version = m_Current.load(std::memory_order_acquire);
+		version->m_Refs.fetch_add(1, std::memory_order_relaxed);
+		return version;
+	}
+
+protected:
+	friend class CTreeLibrary;
+
+	std::atomic<CTreeVersion *> m_Current;
+};
+
+// ȸµΪ
+// Publish߳̽¶,ԭӵ滻ǰ汾,֮AcquireĴ°汾
+// ɰ汾б,ȫͷźCollectɾ
+// Լ: CollectAcquireͬʱ,ڴTick֮(֮֡֡)Collect
+// Acquireİ汾֮ǰᱻɾ,TickвҪκ
+class CTreeLibrary
+{
+public:
+	CTreeLibrary(const CLeafRegistry &registry) :
+		m_Registry(registry)
+	{
+	}
+
+	~CTreeLibrary()
+	{
+		Collect();
+		assert(m_Retired.empty());
+
+		for (std::unordered_map<std::string, std::unique_ptr<CTreeSlot>>::iterator it = m_Slots.begin(); it != m_Slots.end(); ++it)
+		{
+			delete it->second->m_Current.load();
+		}
+	}
+
+	// ΪnameĶ,ʧʱǰ汾,Ϣдerror
+	bool Publish(const std::string &name, const char *text, size_t length, std::string *error = nullptr)
+	{
+		CTreeParser parser(m_Registry);
+		std::unique_ptr<CTreeVersion> version(new CTreeVersion(0));
+		if (!version->GetDefinition().Load(parser, text, length))
+		{
+			if (error != nullptr)
+			{
+				*error = parser.GetError();
+			}
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		std::unique_ptr<CTreeSlot> &slot = m_Slots[name];
+		if (!slot)
+		{
+			slot.reset(new CTreeSlot());
+		}
+
+		CTreeVersion *previous = slot->m_Current.load(std::memory_order_relaxed);
+		version->m_Version = previous != nullptr ? previous->GetVersion() + 1 : 1;
+		slot->m_Current.store(version.release(), std::memory_order_release);
+
+		// ȥе,õĵͷ
+		if (previous != nullptr)
+		{
+			previous->Release();
+			m_Retired.push_back(previous);
+		}
+		return true;
+	}
+
+	// ûзʱؿ,λһɾ
+	CTreeSlot *Find(const std::string &name)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		std::unordered_map<std::string, std::unique_ptr<CTreeSlot>>::iterator it = m_Slots.find(name);
+		return it != m_Slots.end() ? it->second.get() : nullptr;
+	}
+
+	// ɾûõľɰ汾,ɾĸ
+	size_t Collect()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		size_t count = 0;
+		for (size_t i = 0; i < m_Retired.size(); )
+		{
+			if (m_Retired[i]->GetRefs() == 0)
+			{
+				delete m_Retired[i];
+				m_Retired[i] = m_Retired.back();
+				m_Retired.pop_back();
+				++count;
+			}
+			else
+			{
+				++i;
+			}
+		}
+		return count;
+	}
+
+	// дõľɰ汾
+	size_t GetRetiredCount()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Retired.size();
+	}
+
+protected:
+	const CLeafRegistry &m_Registry;
+	std::mutex m_Mutex;
+	std::unordered_map<std::string, std::unique_ptr<CTreeSlot>> m_Slots;
+	std::vector<CTreeVersion *> m_Retired;
+};
+
+// ִж
+// ±ָ߳,̴߳Լ䰴ȡ,ȡȥ̵߳ȡ
+// Լ:
+// 1. ڵͼֻ,ɱ̹߳,Tickڼ䲻޸
+// 2. ÿ(CBehaviorTree)ͬһʱֻһ̷߳,ﲻܷ
+// 3. AddֻTick֮,ڵͼõAddʱ(Prepare)ע
+// 4. 󶨵CTreeSlotĴڸڵ,´οʼǰǰ汾,еһþɰ汾ִ
+class CBehaviorTreeWorld
+{
+public:
+	// threadsΪ0ʱʹӲ߳,Tick߳Ҳִ
+	CBehaviorTreeWorld(size_t threads = 0) :
+		m_ThreadCount(threads != 0 ? threads : std::thread::hardware_concurrency()),
+		m_ChunkSize(64),
+		m_Generation(0),
+		m_Done(0),
+		m_Quit(false)
+	{
+		if (m_ThreadCount == 0)
+		{
+			m_ThreadCount = 1;
+		}
+
+		m_Ranges.reset(new SRange[m_ThreadCount]);
+		for (size_t i = 1; i < m_ThreadCount; ++i)
+		{
+			m_Workers.push_back(std::thread(&CBehaviorTreeWorld::Run, this, i));
+		}
+	}
+
+	~CBehaviorTreeWorld()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Quit = true;
+		}
+		m_Start.notify_all();
+
+		for (size_t i = 0; i < m_Workers.size(); ++i)
+		{
+			m_Workers[i].join();
+		}
+	}
+
+	// ÿÿ֡Ԥ,Ĭϲ
+	// Ԥͬ,ϵĴһִ֡ϴʣµΪ
+	void SetAgentBudget(const STickBudget &budget)
+	{
+		m_Budget = budget;
+	}
+
+	// дTickͳ֮
+	SBudgetStats GetBudgetStats() const
+	{
+		SBudgetStats total = { 0, 0, 0 };
+		for (size_t i = 0; i < m_Agents.size(); ++i)
+		{
+			const SBudgetStats &stats = m_Agents[i].m_Tree.GetBudgetStats();
+			total.m_Frames += stats.m_Frames;
+			total.m_Exhausted += stats.m_Exhausted;
+			total.m_Steps += stats.m_Steps;
+		}
+		return total;
+	}
+
+	// һrootĴ,rootһ֡¿ʼ
+	CBehaviorTree &Add(CNode &root)
+	{
+		m_Agents.emplace_back();
+		SAgent &agent = m_Agents.back();
+		agent.m_Tree.Prepare(root);
+		agent.m_Behavior.Setup(root, &agent.m_Tree);
+		agent.m_Finished = true;
+		return agent.m_Tree;
+	}
+
+	// һslotǰ汾Ĵ,°汾ڸڵʱ
+	CBehaviorTree &Add(CTreeSlot &slot)
+	{
+		m_Agents.emplace_back();
+		SAgent &agent = m_Agents.back();
+		agent.m_Slot = &slot;
+		agent.m_Version = slot.Acquire();
+		agent.m_Tree.Prepare(agent.m_Version->GetRoot());
+		agent.m_Behavior.Setup(agent.m_Version->GetRoot(), &agent.m_Tree);
+		agent.m_Finished = true;
+		return agent.m_Tree;
+	}
+
+	// дִһ,ʱȫִ
+	void Tick()
+	{
+		size_t count = m_Agents.size();
+		for (size_t i = 0; i < m_ThreadCount; ++i)
+		{
+			m_Ranges[i].m_Next = count * i / m_ThreadCount;
+			m_Ranges[i].m_End = count * (i + 1) / m_ThreadCount;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			++m_Generation;
+			m_Done = 0;
+		}
+		m_Start.notify_all();
+
+		Work(0);
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Finish.wait(lock, [this] { return m_Done == m_Workers.size(); });
+	}
+
+	// ÿȡĴ
+	void SetChunkSize(size_t size)
+	{
+		m_ChunkSize = size != 0 ? size : 1;
+	}
+
+	size_t GetThreadCount() const
+	{
+		return m_ThreadCount;
+	}
+
+	size_t GetAgentCount() const
+	{
+		return m_Agents.size();
+	}
+
+	CBehavior &GetBehavior(size_t index)
+	{
+		return m_Agents[index].m_Behavior;
+	}
+
+protected:
+	struct SAgent
+	{
+		SAgent() :
+			m_Slot(nullptr),
+			m_Version(nullptr),
+			m_Finished(true)
+		{
+		}
+
+		// ,ڵڵİ汾ͷ
+		~SAgent()
+		{
+			m_Behavior.Rest();
+			m_Behavior.Teardown();
+			if (m_Version != nullptr)
+			{
+				m_Version->Release();
+			}
+		}
+
+		// ϵִ֮֡ǰ¿ʼ
+		void Tick(const STickBudget &budget)
+		{
+			if (m_Finished && !m_Tree.IsInterrupted())
+			{
+				if (m_Slot != nullptr && m_Slot->Peek() != m_Version)
+				{
+					Migrate();
+				}
+
+				m_Finished = false;
+				BehaviorObserver observer = BehaviorObserver::Bind<SAgent, &SAgent::OnComplete>(this);
+				m_Tree.Start(m_Behavior, &observer);
+			}
+
+			if (budget.IsLimited())
+			{
+				m_Tree.Tick(budget);
+			}
+			else
+			{
+				m_Tree.Tick();
+			}
+		}
+
+		void OnComplete(eStatus)
+		{
+			m_Finished = true;
+		}
+
+		// ڵѽ,ûе
+		// ɾɽڵ,֮ͷžɰ汾
+		// زԤ,°汾һδӶϲ,֮
+		void Migrate()
+		{
+			CTreeVersion *previous = m_Version;
+			m_Version = m_Slot->Acquire();
+			m_Behavior.Setup(m_Version->GetRoot(), &m_Tree);
+			previous->Release();
+		}
+
+		CTreeSlot *m_Slot;
+		CTreeVersion *m_Version;
+		CBehaviorTree m_Tree;
+		CBehavior m_Behavior;
+		bool m_Finished;
+	};
+
+	// ÿ̵߳,뵽һбα
+	struct SRange
+	{
+		std::atomic<size_t> m_Next;
+		size_t m_End;
+		uint8_t m_Padding[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+	};
+
+	void Run(size_t index)
+	{
+		size_t generation = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Start.wait(lock, [&] { return m_Quit || m_Generation != generation; });
+				if (m_Quit)
+				{
+					return;
+				}
+				generation = m_Generation;
+			}
+
+			Work(index);
+
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				++m_Done;
+			}
+			m_Finish.notify_one();
+		}
+	}
+
+	void Work(size_t index)
+	{
+		for (size_t k = 0; k < m_ThreadCount; ++k)
+		{
+			SRange &range = m_Ranges[(index + k) % m_ThreadCount];
+			for (;;)
+			{
+				size_t begin = range.m_Next.fetch_add(m_ChunkSize);
+				if (begin >= range.m_End)
+				{
+					break;
+				}
+
+				size_t end = begin + m_ChunkSize < range.m_End ? begin + m_ChunkSize : range.m_End;
+				for (size_t i = begin; i < end; ++i)
+				{
+					m_Agents[i].Tick(m_Budget);
+				}
+			}
+		}
+	}
+
+	size_t m_ThreadCount;
+	size_t m_ChunkSize;
+	STickBudget m_Budget;
+	std::deque<SAgent> m_Agents;
+	std::unique_ptr<SRange[]> m_Ranges;
+	std::vector<std::thread> m_Workers;
+	std::mutex m_Mutex;
+	std::condition_variable m_Start;
+	std::condition_variable m_Finish;
+	size_t m_Generation;
+	size_t m_Done;
+	bool m_Quit;
+};
+
+void testworld()
+{
+	CBehaviorAllocate t;
+	CNode &root = buildwaittree(t);
+
+	CBehaviorTree bt;
+	CBehavior reference(root, &bt);
+	bt.Prepare(root);
+
+	CBehaviorTreeWorld world(4);
+	world.SetChunkSize(3);
+	for (int i = 0; i < 100; ++i)
+	{
+		world.Add(root);
+	}
+
+	for (int frame = 0; frame < 30; ++frame)
+	{
+		eStatus s = reference.Tick();
+		(void)s;
+		world.Tick();
+		for (size_t i = 0; i < world.GetAgentCount(); ++i)
+		{
+			assert(world.GetBehavior(i).GetStatus() == s);
+		}
+	}
+}
+
+// ȸ: еĴþɰ汾ִһ,һֻ°汾,ɰ汾ú
+void testhotreload()
+{
+	CLeafRegistry registry;
+	registerwaitleaves(registry);
+	CTreeLibrary library(registry);
+
+	std::string error;
+	const char *v1 = "fail(1)";
+	const char *v2 = "sequence { wait(1) }";
+	bool ok = library.Publish("guard", v1, strlen(v1));
+	(void)ok;
+	assert(ok);
+	ok = library.Publish("guard", "sequence {", 10, &error);
+	assert(!ok && !error.empty());
+	CTreeSlot *slot = library.Find("guard");
+	assert(slot != nullptr && slot->Peek()->GetVersion() == 1 && library.Find("none") == nullptr);
+
+	CBehaviorTreeWorld world(2);
+	for (int i = 0; i < 10; ++i)
+	{
+		world.Add(*slot);
+	}
+
+	world.Tick();
+	assert(world.GetBehavior(0).GetStatus() == BH_RUNNING);
+
+	// з,´ʹ°汾
+	ok = library.Publish("guard", v2, strlen(v2));
+	assert(ok);
+	assert(slot->Peek()->GetVersion() == 2 && library.GetRetiredCount() == 1);
+	world.Add(*slot);
+
+	// ɴԾɰ汾һ,Ȼоɰ汾
+	world.Tick();
+	for (size_t i = 0; i < 10; ++i)
+	{
+		assert(world.GetBehavior(i).GetStatus() == BH_FAILURE);
+	}
+	assert(world.GetBehavior(10).GetStatus() == BH_RUNNING);
+	size_t collected = library.Collect();
+	(void)collected;
+	assert(collected == 0);
+
+	// ¿ʼʱ°汾,ɰ汾Ի
+	world.Tick();
+	collected = library.Collect();
+	assert(collected == 1 && library.GetRetiredCount() == 0);
+	assert(world.GetBehavior(10).GetStatus() == BH_SUCCESS);
+	world.Tick();
+	for (size_t i = 0; i < 10; ++i)
+	{
+		assert(world.GetBehavior(i).GetStatus() == BH_SUCCESS);
+	}
+
+	// һ߳Tickڼ䲻Ϸ
+	std::atomic<bool> stop(false);
+	std::thread publisher([&]()
+	{
+		for (int i = 0; !stop; ++i)
+		{
+			const char *text = i % 2 == 0 ? v1 : v2;
+			library.Publish("guard", text, strlen(text));
+			std::this_thread::yield();
+		}
+	});
+	for (int frame = 0; frame < 200; ++frame)
+	{
+		world.Tick();
+		library.Collect();
+	}
+	stop = true;
+	publisher.join();
+
+	// ֡д°汾
+	for (int frame = 0; frame < 3; ++frame)
+	{
+		world.Tick();
+	}
+	library.Collect();
+	assert(library.GetRetiredCount() == 0);
+}
+
+// : һ֡Ϊϻָ,֮ÿ֡״̬ԭΪͬ
+void testsnapshot()
+{
+	CLeafRegistry registry;
+	registerwaitleaves(registry);
+	CTreeParser parser(registry);
+
+	std::string wide = "parallel(all, one) {";
+	for (int i = 0; i < 9; ++i)
+	{
+		wide += " wait(" + std::to_string(i % 4) + ")";
+	}
+	wide += " }";
+
+	const char *texts[] =
+	{
+		k_WaitTreeText,
+		"activeselector { fail(2) sequence { wait(1) repeat(3) { wait(2) } } wait(1) }",
+		"monitor { wait(6) sequence { wait(2) fail(1) } }",
+		"repeat(4) { selector { fail(1) parallel(one, all) { wait(3) fail(1) } wait(2) } }",
+		wide.c_str(),
+	};
+
+	std::vector<uint8_t> buffer;
+	for (size_t t = 0; t < sizeof(texts) / sizeof(texts[0]); ++t)
+	{
+		CTreeDefinition definition;
+		bool ok = definition.Load(parser, texts[t], strlen(texts[t]));
+		assert(ok);
+		CNode &root = *definition.GetRoot();
+
+		for (int frame = 0; frame < 12; ++frame)
+		{
+			CBehavior a(root);
+			for (int i = 0; i < frame; ++i)
+			{
+				a.Tick();
+			}
+
+			ok = SaveSnapshot(a, buffer);
+			assert(ok);
+			CBehavior b(root);
+			b.Tick();
+			ok = LoadSnapshot(b, &buffer[0], buffer.size());
+			assert(ok && b.GetStatus() == a.GetStatus());
+
+			for (int i = 0; i < 12; ++i)
+			{
+				eStatus s = a.Tick();
+				eStatus r = b.Tick();
+				assert(r == s);
+				(void)s;
+				(void)r;
+			}
+		}
+		(void)ok;
+	}
+
+	// ضϻ,ԼͬĽڵͼ,ָʧܺͷʼ
+	CTreeDefinition definition;
+	bool ok = definition.Load(parser, k_WaitTreeText, strlen(k_WaitTreeText));
+	assert(ok);
+	CBehavior a(*definition.GetRoot());
+	for (int i = 0; i < 5; ++i)
+	{
+		a.Tick();
+	}
+	ok = SaveSnapshot(a, buffer);
+	assert(ok);
+
+	CBehavior b(*definition.GetRoot());
+	for (size_t size = 0; size < buffer.size(); ++size)
+	{
+		ok = LoadSnapshot(b, &buffer[0], size);
+		assert(!ok && b.GetStatus() == BH_INVALID);
+	}
+	buffer.push_back(0);
+	ok = LoadSnapshot(b, &buffer[0], buffer.size());
+	assert(!ok);
+	buffer.pop_back();
+
+	const char *other = "sequence { wait(1) }";
+	CTreeDefinition small;
+	ok = small.Load(parser, other, strlen(other));
+	assert(ok);
+	CBehavior c(*small.GetRoot());
+	ok = LoadSnapshot(c, &buffer[0], buffer.size());
+	assert(!ok);
+	c.Tick();
+
+	// Сڴ,ڵ㲻ͬظڵ
+	const char *repeat = "repeat(3) { wait(1) }";
+	CTreeDefinition repeated;
+	ok = repeated.Load(parser, repeat, strlen(repeat));
+	assert(ok);
+	CBehavior r(*repeated.GetRoot());
+	const uint8_t overrun[] = { k_SnapshotVersion, 0, BH_RUNNING, 3, 5, BH_INVALID };
+	const uint8_t limit[] = { k_SnapshotVersion, 0, BH_RUNNING, 4, 1, BH_INVALID };
+	const uint8_t wait[] = { k_SnapshotVersion, 0, BH_RUNNING, 3, 1, BH_RUNNING, 2 };
+	const uint8_t valid[] = { k_SnapshotVersion, 0, BH_RUNNING, 3, 2, BH_RUNNING, 1 };
+	ok = LoadSnapshot(r, overrun, sizeof(overrun));
+	assert(!ok);
+	ok = LoadSnapshot(r, limit, sizeof(limit));
+	assert(!ok);
+	ok = LoadSnapshot(r, wait, sizeof(wait));
+	assert(!ok);
+	ok = LoadSnapshot(r, valid, sizeof(valid));
+	assert(ok);
+	eStatus s = r.Tick();
+	assert(s == BH_RUNNING);
+	s = r.Tick();
+	assert(s == BH_SUCCESS);
+
+	// ûSetupΪ
+	CBehavior empty;
+	ok = LoadSnapshot(empty, valid, sizeof(valid));
+	assert(!ok);
+
+	// ʧܺԿ
+	CBehavior reference(*definition.GetRoot());
+	for (int i = 0; i < 30; ++i)
+	{
+		s = reference.Tick();
+		eStatus f = b.Tick();
+		assert(f == s);
+		(void)f;
+	}
+
+	// ȵĸʱ,ָһ,¹϶ʱ,ԭͬһ֡
+	// ڰֵһָ,뵱ǰֵͬļӰ汾
+	CBlackboardLayout layout;
+	SBlackboardKey<int> ammo = layout.Declare<int>("ammo", 3);
+	CBehaviorAllocate allocate;
+	CMockRepeat &sleeper = allocate.allocate<CMockRepeat>(&allocate.allocate<CSleepNode>(5, BH_SUCCESS));
+	sleeper.SetParam(3);
+	CBehaviorTree source, target;
+	source.Prepare(sleeper);
+	target.Prepare(sleeper);
+	source.GetBlackboard().Reset(layout);
+	target.GetBlackboard().Reset(layout);
+	source.GetBlackboard().Set(ammo, 7);
+
+	CBehavior sa(sleeper, &source);
+	source.Start(sa);
+	for (int i = 0; i < 7; ++i)
+	{
+		source.Tick();
+	}
+	ok = SaveSnapshot(sa, buffer);
+	assert(ok && sa.IsSuspended());
+
+	// ضϵĿղĶڰ
+	CBehavior sb(sleeper, &target);
+	ok = LoadSnapshot(sb, &buffer[0], buffer.size() - 1);
+	assert(!ok && target.GetBlackboard().Get(ammo) == 3 && target.GetTimerCount() == 0);
+	ok = LoadSnapshot(sb, &buffer[0], buffer.size());
+	assert(ok && sb.IsSuspended() && target.GetTimerCount() == 1);
+	assert(target.GetBlackboard().Get(ammo) == 7 && target.GetBlackboard().GetVersion(ammo.m_Index) == 1);
+	target.Restore(sb);
+
+	int completed = 0;
+	for (int i = 0; i < 12; ++i)
+	{
+		source.Tick();
+		target.Tick();
+		assert(sb.GetStatus() == sa.GetStatus());
+		completed += sb.GetStatus() == BH_SUCCESS;
+	}
+	assert(completed == 1);
+	(void)completed;
+
+	// ڰĿղָܻûкڰĴ
+	CBehaviorTree bare;
+	bare.Prepare(sleeper);
+	CBehavior sc(sleeper, &bare);
+	ok = LoadSnapshot(sc, &buffer[0], buffer.size());
+	assert(!ok && bare.GetTimerCount() == 0);
+
+	// ¼ĸֿ֧
+	CBehaviorTree driven;
+	CMockSequence &sequence = allocate.allocate<CMockSequence>();
+	sequence.Reserve(allocate, 1);
+	sequence.AddChild(allocate.allocate<CWaitNode>(2, BH_SUCCESS));
+	driven.Prepare(sequence);
+	CBehavior ea(sequence, &driven);
+	driven.Start(ea);
+	driven.Tick();
+	ok = SaveSnapshot(ea, buffer);
+	assert(!ok && buffer.empty());
+	ok = LoadSnapshot(ea, valid, sizeof(valid));
+	assert(!ok && ea.IsRunning());
+	(void)ok;
+	(void)s;
+}
+
+// ÿ뱣ͻָĴ,մС
+void benchsnapshot()
+{
+	const int k_Agents = 10000;
+	CLeafRegistry registry;
+	registerwaitleaves(registry);
+	CTreeParser parser(registry);
+	CTreeDefinition definition;
+	definition.Load(parser, k_WaitTreeText, strlen(k_WaitTreeText));
+	CNode &root = *definition.GetRoot();
+
+	std::vector<CBehavior> agents(k_Agents);
+	for (int i = 0; i < k_Agents; ++i)
+	{
+		agents[i].Setup(root);
+		for (int frame = 0; frame < i % 8; ++frame)
+		{
+			agents[i].Tick();
+		}
+	}
+
+	std::vector<std::vector<uint8_t>> snapshots(k_Agents);
+	size_t bytes = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < k_Agents; ++i)
+	{
+		SaveSnapshot(agents[i], snapshots[i]);
+		bytes += snapshots[i].size();
+	}
+	double save = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<CBehavior> restored(k_Agents);
+	for (int i = 0; i < k_Agents; ++i)
+	{
+		restored[i].Setup(root);
+	}
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < k_Agents; ++i)
+	{
+		LoadSnapshot(restored[i], &snapshots[i][0], snapshots[i].size());
+	}
+	double load = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("snapshot agents=%d save=%.0f/s load=%.0f/s bytes/agent=%.1f\n", k_Agents, k_Agents / save, k_Agents / load, static_cast<double>(bytes) / k_Agents);
+}
+
+// Tick: Ԥ´δжϴ,ÿΪÿִֻ֡һ
+void testbudget()
+{
+	const int k_Count = 8;
+	CWaitNode n(100, BH_SUCCESS);
+	CBehaviorTree bt;
+	CBehavior behaviors[k_Count];
+	for (int i = 0; i < k_Count; ++i)
+	{
+		behaviors[i].Setup(n, &bt);
+		bt.Start(behaviors[i]);
+	}
+
+	int expected[] = { 3, 6, 8 };
+	(void)expected;
+	bool finished;
+	for (int call = 0; call < 3; ++call)
+	{
+		finished = bt.Tick(STickBudget(3));
+		assert(finished == (call == 2));
+		int ticked = 0;
+		for (int i = 0; i < k_Count; ++i)
+		{
+			ticked += behaviors[i].IsRunning() ? 1 : 0;
+		}
+		assert(ticked == expected[call]);
+	}
+	assert(!bt.IsInterrupted());
+	for (int i = 0; i < k_Count; ++i)
+	{
+		assert(behaviors[i].Get<CWaitTask>()->m_Remaining == 99);
+	}
+
+	// Ԥǡùʱִ֡
+	finished = bt.Tick(STickBudget(k_Count));
+	assert(finished);
+	assert(bt.GetBudgetStats().m_Frames == 2);
+	assert(bt.GetBudgetStats().m_Exhausted == 2);
+	assert(bt.GetBudgetStats().m_Steps == 2 * k_Count);
+
+	// Tickִ걻ϵ֡
+	finished = bt.Tick(STickBudget(5));
+	assert(!finished);
+	bt.Tick();
+	assert(!bt.IsInterrupted());
+	for (int i = 0; i < k_Count; ++i)
+	{
+		assert(behaviors[i].Get<CWaitTask>()->m_Remaining == 97);
+	}
+	finished = bt.Tick(STickBudget(0, 1000000));
+	assert(finished);
+	(void)finished;
+
+	for (int i = 0; i < k_Count; ++i)
+	{
+		behaviors[i].Abort();
+	}
+
+	// ÿÿִ֡һ
+	CBehaviorAllocate t;
+	CNode &root = buildwaittree(t);
+	CBehaviorTreeWorld world(2);
+	world.SetAgentBudget(STickBudget(1));
+	for (int i = 0; i < 10; ++i)
+	{
+		world.Add(root);
+	}
+	for (int frame = 0; frame < 30; ++frame)
+	{
+		world.Tick();
+	}
+	SBudgetStats stats = world.GetBudgetStats();
+	(void)stats;
+	assert(stats.m_Steps == 300);
+	assert(stats.m_Exhausted > 0);
+	assert(stats.m_Frames + stats.m_Exhausted == 300);
+}
+
+// ּ
+// ,ǷеȷֵͬƵʵȼ,ȼiÿm_Periods[i]֡Tickһ
+// ͬһȼĴλɢ֡,⼯ͬһ֡
+// ȼı´TickʼʱЧ,ȵĽֻȡڵõ˳,е״̬޹
+class CTickScheduler
+{
+public:
+	typedef uint32_t Handle;
+	static const Handle k_InvalidHandle = 0xFFFFFFFF;
+
+	// periodsΪȼļ֡,С
+	CTickScheduler(std::initializer_list<uint32_t> periods = { 1, 4, 16 }) :
+		m_Frame(0),
+		m_Ticked(0),
+		m_FreeList(k_InvalidHandle)
+	{
+		for (uint32_t period : periods)
+		{
+			assert(period != 0);
+			assert(m_Tiers.empty() || m_Tiers.back().m_Period < period);
+			m_Tiers.emplace_back();
+			m_Tiers.back().m_Period = period;
+			m_Tiers.back().m_Buckets.resize(period);
+		}
+	}
+
+	// Ӵ,ȼtierдٵλ
+	Handle Add(CBehaviorTree &tree, uint8_t tier = 0)
+	{
+		assert(tier < m_Tiers.size());
+		Handle handle;
+		if (m_FreeList != k_InvalidHandle)
+		{
+			handle = m_FreeList;
+			m_FreeList = m_Agents[handle].m_Slot;
+		}
+		else
+		{
+			handle = static_cast<Handle>(m_Agents.size());
+			m_Agents.emplace_back();
+		}
+
+		SAgent &agent = m_Agents[handle];
+		agent.m_Tree = &tree;
+		agent.m_LastFrame = m_Frame;
+		agent.m_Pending = tier;
+		Insert(handle, tier);
+		return handle;
+	}
+
+	void Remove(Handle handle)
+	{
+		SAgent &agent = At(handle);
+		Erase(handle);
+		agent.m_Tree = nullptr;
+		agent.m_Slot = m_FreeList;
+		m_FreeList = handle;
+	}
+
+	// ıĵȼ,´TickʼʱЧ
+	void SetTier(Handle handle, uint8_t tier)
+	{
+		assert(tier < m_Tiers.size());
+		SAgent &agent = At(handle);
+		if (agent.m_Pending == tier)
+		{
+			return;
+		}
+
+		if (agent.m_Pending == agent.m_Tier)
+		{
+			m_Moves.push_back(handle);
+		}
+		agent.m_Pending = tier;
+	}
+
+	uint8_t GetTier(Handle handle) const
+	{
+		return m_Agents[handle].m_Pending;
+	}
+
+	// ִһ֡: ȼλڵǰ֡ĴTickһ
+	void Tick()
+	{
+		ApplyMoves();
+
+		m_Ticked = 0;
+		for (size_t t = 0; t < m_Tiers.size(); ++t)
+		{
+			STier &tier = m_Tiers[t];
+			std::vector<Handle> &bucket = tier.m_Buckets[m_Frame % tier.m_Period];
+			for (size_t i = 0; i < bucket.size(); ++i)
+			{
+				SAgent &agent = m_Agents[bucket[i]];
+				agent.m_Tree->SetElapsedFrames(static_cast<uint32_t>(m_Frame + 1 - agent.m_LastFrame));
+				agent.m_LastFrame = m_Frame + 1;
+				agent.m_Tree->Tick();
+			}
+			m_Ticked += bucket.size();
+		}
+		++m_Frame;
+	}
+
+	uint64_t GetFrame() const
+	{
+		return m_Frame;
+	}
+
+	// һ֡TickĴ
+	size_t GetTickedCount() const
+	{
+		return m_Ticked;
+	}
+
+	size_t GetTierCount() const
+	{
+		return m_Tiers.size();
+	}
+
+protected:
+	struct SAgent
+	{
+		CBehaviorTree *m_Tree;
+		uint64_t m_LastFrame;
+		// Ͱе±,ʱΪһ
+		uint32_t m_Slot;
+		uint16_t m_Phase;
+		uint8_t m_Tier;
+		uint8_t m_Pending;
+	};
+
+	struct STier
+	{
+		uint32_t m_Period;
+		std::vector<std::vector<Handle> > m_Buckets;
+	};
+
+	SAgent &At(Handle handle)
+	{
+		assert(handle < m_Agents.size() && m_Agents[handle].m_Tree != nullptr);
+		return m_Agents[handle];
+	}
+
+	// ȡٵλ,ͬʱȡ뵱ǰ֡
+	void Insert(Handle handle, uint8_t tier)
+	{
+		STier &target = m_Tiers[tier];
+		uint32_t best = 0;
+		size_t bestSize = std::numeric_limits<size_t>::max();
+		for (uint32_t k = 0; k < target.m_Period; ++k)
+		{
+			uint32_t phase = static_cast<uint32_t>((m_Frame + k) % target.m_Period);
+			if (target.m_Buckets[phase].size() < bestSize)
+			{
+				best = phase;
+				bestSize = target.m_Buckets[phase].size();
+			}
+		}
+
+		SAgent &agent = m_Agents[handle];
+		agent.m_Tier = tier;
+		agent.m_Phase = static_cast<uint16_t>(best);
+		agent.m_Slot = static_cast<uint32_t>(target.m_Buckets[best].size());
+		target.m_Buckets[best].push_back(handle);
+	}
+
+	// Ͱһɾ
+	void Erase(Handle handle)
+	{
+		SAgent &agent = m_Agents[handle];
+		std::vector<Handle> &bucket = m_Tiers[agent.m_Tier].m_Buckets[agent.m_Phase];
+		Handle last = bucket.back();
+		bucket[agent.m_Slot] = last;
+		m_Agents[last].m_Slot = agent.m_Slot;
+		bucket.pop_back();
+	}
+
+	void ApplyMoves()
+	{
+		for (size_t i = 0; i < m_Moves.size(); ++i)
+		{
+			Handle handle = m_Moves[i];
+			SAgent &agent = m_Agents[handle];
+			if (agent.m_Tree == nullptr || agent.m_Pending == agent.m_Tier)
+			{
+				continue;
+			}
+
+			Erase(handle);
+			Insert(handle, agent.m_Pending);
+		}
+		m_Moves.clear();
+	}
+
+	std::vector<STier> m_Tiers;
+	std::vector<SAgent> m_Agents;
+	std::vector<Handle> m_Moves;
+	uint64_t m_Frame;
+	size_t m_Ticked;
+	Handle m_FreeList;
+};
+
+void testtickscheduler()
+{
+	CBehaviorAllocate t;
+	CWaitNode &wait = t.allocate<CWaitNode>(1000, BH_SUCCESS);
+	const size_t k_Agents = 64;
+	std::deque<CBehaviorTree> trees(k_Agents);
+	std::deque<CBehavior> behaviors(k_Agents);
+
+	// ͬһȼĴƽֵ֡
+	CTickScheduler scheduler;
+	std::vector<CTickScheduler::Handle> handles;
+	for (size_t i = 0; i < k_Agents; ++i)
+	{
+		behaviors[i].Setup(wait, &trees[i]);
+		trees[i].Start(behaviors[i]);
+		handles.push_back(scheduler.Add(trees[i], 1));
+	}
+	for (int frame = 0; frame < 8; ++frame)
+	{
+		scheduler.Tick();
+		assert(scheduler.GetTickedCount() == k_Agents / 4);
+	}
+	assert(behaviors[0].Get<CWaitTask>()->m_Remaining == 998);
+	assert(trees[0].GetElapsedFrames() == 4);
+
+	// еĴһ֡ʼÿ֡Tick,״̬Ӱ
+	uint32_t remaining = behaviors[5].Get<CWaitTask>()->m_Remaining;
+	(void)remaining;
+	scheduler.SetTier(handles[5], 0);
+	scheduler.SetTier(handles[6], 2);
+	scheduler.Tick();
+	assert(behaviors[5].Get<CWaitTask>()->m_Remaining == remaining - 1);
+	scheduler.Tick();
+	assert(behaviors[5].Get<CWaitTask>()->m_Remaining == remaining - 2);
+	assert(trees[5].GetElapsedFrames() == 1);
+	assert(scheduler.GetTier(handles[6]) == 2);
+
+	// ,Ƴճλø
+	for (int frame = 0; frame < 16; ++frame)
+	{
+		scheduler.Tick();
+	}
+	assert(trees[6].GetElapsedFrames() == 16);
+	scheduler.Remove(handles[7]);
+	CTickScheduler::Handle reused = scheduler.Add(trees[7], 2);
+	assert(reused == handles[7]);
+	(void)reused;
+
+	for (size_t i = 0; i < k_Agents; ++i)
+	{
+		behaviors[i].Abort();
+	}
+}
+
+// ȫÿ֡TickͰ1:3:6ֵȼʱ,ÿ֡ƽʱ
+void benchtickscheduler()
+{
+	const size_t k_Agents = 10000;
+	const int k_Frames = 256;
+	CBehaviorAllocate t;
+	CWaitNode &wait = t.allocate<CWaitNode>(k_Frames * 2, BH_SUCCESS);
+
+	for (int lod = 0; lod < 2; ++lod)
+	{
+		std::deque<CBehaviorTree> trees(k_Agents);
+		std::deque<CBehavior> behaviors(k_Agents);
+		CTickScheduler scheduler;
+		for (size_t i = 0; i < k_Agents; ++i)
+		{
+			trees[i].Prepare(wait);
+			behaviors[i].Setup(wait, &trees[i]);
+			trees[i].Start(behaviors[i]);
+			uint8_t tier = lod == 0 ? 0 : (i % 10 == 0 ? 0 : (i % 10 < 4 ? 1 : 2));
+			scheduler.Add(trees[i], tier);
+		}
+
+		double total = 0, longest = 0;
+		for (int frame = 0; frame < k_Frames; ++frame)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			scheduler.Tick();
+			double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+			total += us;
+			longest = us > longest ? us : longest;
+		}
+		printf("lod agents=%d tiers=%s avg=%.1fus/frame max=%.1fus/frame\n", static_cast<int>(k_Agents), lod == 0 ? "all-1" : "1:3:6", total / k_Frames, longest);
+
+		for (size_t i = 0; i < k_Agents; ++i)
+		{
+			behaviors[i].Abort();
+		}
+	}
+}
+
+// ͬ߳ÿִеĴ
+void benchworld()
+{
+	CBehaviorAllocate t;
+	CNode &root = buildwaittree(t);
+	const size_t k_Agents = 20000;
+	const int k_Frames = 100;
+
+	size_t cores = std::thread::hardware_concurrency();
+	if (cores == 0)
+	{
+		cores = 1;
+	}
+
+	for (size_t threads = 1; ; threads = threads * 2 < cores ? threads * 2 : cores)
+	{
+		CBehaviorTreeWorld world(threads);
+		for (size_t i = 0; i < k_Agents; ++i)
+		{
+			world.Add(root);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < k_Frames; ++frame)
+		{
+			world.Tick();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("world threads=%zu agents=%zu ticks/sec=%.0f\n", threads, k_Agents, k_Agents * k_Frames / seconds);
+
+		if (threads == cores)
+		{
+			break;
+		}
+	}
+}
+
+// 󶨵ȸ¶ĴֱʹýڵͼĴ,ÿ֡ÿĺʱ
+void benchhotreload()
+{
+	const int k_Agents = 10000;
+	const int k_Frames = 200;
+	CLeafRegistry registry;
+	registerwaitleaves(registry);
+	CTreeLibrary library(registry);
+	library.Publish("wait", k_WaitTreeText, strlen(k_WaitTreeText));
+	CTreeSlot &slot = *library.Find("wait");
+	CTreeVersion *version = slot.Acquire();
+
+	for (int bound = 0; bound < 2; ++bound)
+	{
+		CBehaviorTreeWorld world(1);
+		for (int i = 0; i < k_Agents; ++i)
+		{
+			if (bound != 0)
+			{
+				world.Add(slot);
+			}
+			else
+			{
+				world.Add(version->GetRoot());
+			}
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < k_Frames; ++frame)
+		{
+			world.Tick();
+		}
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (k_Agents * k_Frames);
+		printf("hotreload agents=%d bound=%d %.1fns/agent\n", k_Agents, bound, ns);
+	}
+	version->Release();
+}
+
+void testringbuffer()
+{
+	CRingBuffer<int> q;
+	q.Reserve(4);
+	assert(q.GetCapacity() == 4);
+	int v;
+
+	// dequeͬͷβ,ƻ
+	for (int round = 0; round < 10; ++round)
+	{
+		q.PushBack(1);
+		q.PushBack(2);
+		q.PushFront(0);
+		assert(q.GetSize() == 3);
+		v = q.PopFront();
+		assert(v == 0);
+		v = q.PopFront();
+		assert(v == 1);
+		v = q.PopFront();
+		assert(v == 2);
+		assert(q.IsEmpty());
+	}
+	assert(q.GetCapacity() == 4);
+
+	// ʱ˳
+	for (int i = 0; i < 5; ++i)
+	{
+		q.PushBack(i);
+	}
+	assert(q.GetCapacity() == 8);
+	for (int i = 0; i < 5; ++i)
+	{
+		v = q.PopFront();
+		assert(v == i);
+	}
+	(void)v;
+}
+
+// ȶаװͬĽӿ,ڶԱ
+struct SDequeQueue
+{
+	void PushBack(CBehavior *behavior)
+	{
+		m_Queue.push_back(behavior);
+	}
+
+	CBehavior *PopFront()
+	{
+		CBehavior *behavior = m_Queue.front();
+		m_Queue.pop_front();
+		return behavior;
+	}
+
+	std::deque<CBehavior *> m_Queue;
+};
+
+// ģCBehaviorTree::Tick,ΪRunning,ÿ֡Ӻ
+template <class QUEUE>
+double benchqueue(QUEUE &queue, size_t running, int frames)
+{
+	std::vector<CBehavior> behaviors(running);
+	for (size_t i = 0; i < running; ++i)
+	{
+		queue.PushBack(&behaviors[i]);
+	}
+
+	size_t steps = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		queue.PushBack(nullptr);
+		for (CBehavior *current = queue.PopFront(); current != nullptr; current = queue.PopFront())
+		{
+			++steps;
+			queue.PushBack(current);
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return seconds * 1e9 / steps;
+}
+
+void benchscheduler()
+{
+	const size_t k_Running[] = { 4, 64, 1024 };
+	for (size_t i = 0; i < sizeof(k_Running) / sizeof(k_Running[0]); ++i)
+	{
+		int frames = static_cast<int>(4000000 / k_Running[i]);
+
+		SDequeQueue deque;
+		double dequeNs = benchqueue(deque, k_Running[i], frames);
+
+		CRingBuffer<CBehavior *> ring;
+		ring.Reserve(k_Running[i] + 1);
+		double ringNs = benchqueue(ring, k_Running[i], frames);
+
+		printf("scheduler running=%zu deque=%.2fns/step ring=%.2fns/step\n", k_Running[i], dequeNs, ringNs);
+	}
+}
+
+struct SObserverRecord
+{
+	void OnComplete(eStatus status)
+	{
+		++m_Called;
+		m_Status = status;
+	}
+
+	int m_Called;
+	eStatus m_Status;
+};
+
+void testobserver()
+{
+	assert(sizeof(BehaviorObserver) == 2 * sizeof(void *));
+
+	CBehaviorTree bt;
+	CWaitNode n(1, BH_FAILURE);
+	bt.Prepare(n);
+	CBehavior b(n, &bt);
+
+	SObserverRecord record = { 0, BH_INVALID };
+	BehaviorObserver observer = BehaviorObserver::Bind<SObserverRecord, &SObserverRecord::OnComplete>(&record);
+	bt.Start(b, &observer);
+
+	bt.Tick();
+	assert(record.m_Called == 0 && b.IsRunning());
+	bt.Tick();
+	assert(record.m_Called == 1 && record.m_Status == BH_FAILURE);
+
+	// ڵȶ
+	bt.Tick();
+	assert(record.m_Called == 1);
+}
+
+void testeventdriven()
+{
+	CBehaviorAllocate t;
+	CMockSequence &root = t.allocate<CMockSequence>();
+	root.Reserve(t, 3);
+	root.AddChild(t.allocate<CWaitNode>(1, BH_SUCCESS));
+
+	CMockSelector &se = t.allocate<CMockSelector>();
+	root.AddChild(se);
+	se.Reserve(t, 2);
+	se.AddChild(t.allocate<CWaitNode>(1, BH_FAILURE));
+	se.AddChild(t.allocate<CWaitNode>(0, BH_SUCCESS));
+
+	CMockSequence &sq = t.allocate<CMockSequence>();
+	root.AddChild(sq);
+	sq.Reserve(t, 1);
+	sq.AddChild(t.allocate<CWaitNode>(2, BH_SUCCESS));
+
+	CBehaviorTree polling;
+	CBehavior p(root, &polling);
+
+	CBehaviorTree bt;
+	bt.Prepare(root);
+	CBehavior b(root, &bt);
+	bt.Start(b);
+
+	// ѯĽһ,ȶֻеҶ
+	int frames = 0;
+	do
+	{
+		eStatus s = p.Tick();
+		(void)s;
+		bt.Tick();
+		assert(b.GetStatus() == s);
+		assert(bt.GetScheduledCount() <= 1);
+		++frames;
+	} while (b.IsRunning());
+
+	assert(frames == 5 && b.GetStatus() == BH_SUCCESS);
+	assert(bt.GetScheduledCount() == 0);
+	assert(bt.GetTaskPool().GetMisses() == 0);
+}
+
+// depthǶ׵,һticksεҶ
+CNode &builddeeptree(CBehaviorAllocate &t, int depth, uint32_t ticks)
+{
+	CMockSequence &root = t.allocate<CMockSequence>();
+	CMockSequence *parent = &root;
+	for (int i = 1; i < depth; ++i)
+	{
+		CMockSequence &child = t.allocate<CMockSequence>();
+		parent->Reserve(t, 1);
+		parent->AddChild(child);
+		parent = &child;
+	}
+	parent->Reserve(t, 1);
+	parent->AddChild(t.allocate<CWaitNode>(ticks, BH_SUCCESS));
+	return root;
+}
+
+// ѯ¼ÿTickĺʱ
+void benchevent()
+{
+	const int k_Depth[] = { 4, 16, 64 };
+	const size_t k_Agents = 1000;
+	const int k_Frames = 1000;
+
+	for (size_t d = 0; d < sizeof(k_Depth) / sizeof(k_Depth[0]); ++d)
+	{
+		CBehaviorAllocate t;
+		CNode &root = builddeeptree(t, k_Depth[d], k_Frames * 2);
+
+		std::deque<CBehaviorTree> trees(k_Agents);
+		std::deque<CBehavior> polling(k_Agents);
+		std::deque<CBehavior> events(k_Agents);
+		for (size_t i = 0; i < k_Agents; ++i)
+		{
+			trees[i].Prepare(root);
+			polling[i].Setup(root, &trees[i]);
+			events[i].Setup(root, &trees[i]);
+			trees[i].Start(events[i]);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < k_Frames; ++frame)
+		{
+			for (size_t i = 0; i < k_Agents; ++i)
+			{
+				polling[i].Tick();
+			}
+		}
+		double pollingNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (k_Agents * k_Frames);
+
+		start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < k_Frames; ++frame)
+		{
+			for (size_t i = 0; i < k_Agents; ++i)
+			{
+				trees[i].Tick();
+			}
+		}
+		double eventNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (k_Agents * k_Frames);
+
+		printf("event depth=%d polling=%.1fns/tick event=%.1fns/tick\n", k_Depth[d], pollingNs, eventNs);
+	}
+}
+
+void testparallelstate()
+{
+	CBehaviorAllocate t;
+	CMockParallel &p = t.allocate<CMockParallel>();
+	p.SetParam(CParallel::MakeParam(CParallel::RequireAll, CParallel::RequireOne));
+	p.Reserve(t, 3);
+	for (uint32_t i = 1; i <= 3; ++i)
+	{
+		p.AddChild(t.allocate<CWaitNode>(i, BH_SUCCESS));
+	}
+
+	CBehaviorTree bt;
+	bt.Prepare(p);
+	CBehavior b(p, &bt);
+
+	// ӽڵ㱣Running״̬,֮ÿTickٴ
+	eStatus s = b.Tick();
+	assert(s == BH_RUNNING);
+	size_t hits = bt.GetTaskPool().GetHits();
+	s = b.Tick();
+	assert(s == BH_RUNNING);
+	assert(b.Get<CParallel>()->GetBehavior(0).GetStatus() == BH_SUCCESS);
+	s = b.Tick();
+	assert(s == BH_RUNNING);
+	s = b.Tick();
+	assert(s == BH_SUCCESS);
+	assert(bt.GetTaskPool().GetHits() == hits);
+	assert(bt.GetTaskPool().GetMisses() == 0);
+	(void)hits;
+
+	// һɹʱ,ֻеӽڵ
+	CMockParallel &q = t.allocate<CMockParallel>();
+	q.SetParam(CParallel::MakeParam(CParallel::RequireOne, CParallel::RequireOne));
+	q.Reserve(t, 3);
+	q.AddChild(t.allocate<CMockNode>());
+	q.AddChild(t.allocate<CWaitNode>(0, BH_SUCCESS));
+	q.AddChild(t.allocate<CMockNode>());
+
+	CBehavior c(q, &bt);
+	s = c.Tick();
+	assert(s == BH_SUCCESS);
+	CParallel *parallel = c.Get<CParallel>();
+	assert(parallel->GetBehavior(0).GetStatus() == BH_ABORTED);
+	assert(parallel->GetBehavior(0).Get<CMockTask>()->m_TerminateStatus == BH_ABORTED);
+	assert(parallel->GetBehavior(1).GetStatus() == BH_SUCCESS);
+	assert(parallel->GetBehavior(2).GetStatus() == BH_INVALID);
+	assert(parallel->GetBehavior(2).Get<CMockTask>()->m_TerminateCalled == 0);
+	(void)s;
+	(void)parallel;
+}
+
+// ڰȽϷʽ
+enum eCompare
+{
+	CMP_EQUAL,
+	CMP_NOT_EQUAL,
+	CMP_LESS,
+	CMP_GREATER,
+};
+
+template <class T>
+bool Compare(eCompare compare, const T &a, const T &b)
+{
+	switch (compare)
+	{
+	case CMP_EQUAL:
+		return a == b;
+	case CMP_NOT_EQUAL:
+		return !(a == b);
+	case CMP_LESS:
+		return a < b;
+	case CMP_GREATER:
+		return b < a;
+	}
+	return false;
+}
+
+template <class T>
+class CBlackboardWaitTask;
+
+// ȴڰϵֵȽϺɹ
+template <class T>
+struct CBlackboardWaitNode :public CNode
+{
+	CBlackboardWaitNode(SBlackboardKey<T> key, eCompare compare, const T &value) :
+		m_Key(key),
+		m_Compare(compare),
+		m_Value(value)
+	{
+	}
+
+	virtual CTask *Create(CBehaviorTree *bt)
+	{
+		return CreateTask<CBlackboardWaitTask<T> >(*this, bt);
+	}
+
+	virtual void Destroy(CTask *task)
+	{
+		DestroyTask<CBlackboardWaitTask<T> >(task);
+	}
+
+	virtual void Measure(STaskDemand &demand) const
+	{
+		demand.Add<CBlackboardWaitTask<T> >();
+	}
+
+	SBlackboardKey<T> m_Key;
+	eCompare m_Compare;
+	T m_Value;
+};
+
+// ѯʱÿTickȽһ
+// ¼ʱȶ,ںڰϵȸü仯ʱٱȽ
+template <class T>
+class CBlackboardWaitTask :public CTask
+{
+public:
+	CBlackboardWaitTask(CNode &node) :
+		CTask(node),
+		m_Owner(nullptr)
+	{
+		m_Watch.Bind<CBlackboardWaitTask, &CBlackboardWaitTask::onChanged>(this);
+	}
+
+	typedef CBlackboardWaitTask Self;
+	typedef CTask Base;
+
+	CBlackboardWaitNode<T> &GetNode()
+	{
+		return *static_cast<CBlackboardWaitNode<T> *>(m_Node);
+	}
+
+	virtual eStatus Update()
+	{
+		return Test() ? BH_SUCCESS : BH_RUNNING;
+	}
+
+	// ѾʱճŶ,һStepɹ
+	virtual bool OnStart(CBehavior &owner)
+	{
+		if (Test())
+		{
+			return false;
+		}
+
+		m_Owner = &owner;
+		m_BehaviorTree->GetBlackboard().Watch(m_Watch, GetNode().m_Key.m_Index);
+		return true;
+	}
+
+	virtual void OnTerminate(eStatus)
+	{
+		m_Watch.Unwatch();
+	}
+
+	// Stop֮ѱڵ,ժ֪ͨ
+	void onChanged(uint16_t)
+	{
+		if (Test())
+		{
+			m_Watch.Unwatch();
+			m_BehaviorTree->Stop(*m_Owner, BH_SUCCESS);
+		}
+	}
+
+protected:
+	bool Test()
+	{
+		assert(m_BehaviorTree != nullptr);
+		CBlackboardWaitNode<T> &node = GetNode();
+		return Compare(node.m_Compare, m_BehaviorTree->GetBlackboard().Get(node.m_Key), node.m_Value);
+	}
+
+	CBehavior *m_Owner;
+	CBlackboardWatch m_Watch;
+};
+
+struct SBlackboardPoint
+{
+	float m_X;
+	float m_Y;
+};
+
+void testblackboard()
+{
+	CBlackboardLayout layout;
+	SBlackboardKey<int> ammo = layout.Declare<int>("ammo", 3);
+	SBlackboardKey<float> health = layout.Declare<float>("health", 1.0f);
+	(void)health;
+	SBlackboardKey<SBlackboardPoint> target = layout.Declare<SBlackboardPoint>("target");
+	SBlackboardKey<bool> alarm = layout.Declare<bool>("alarm");
+	SBlackboardKey<int> again = layout.Declare<int>("ammo");
+	assert(again.m_Offset == ammo.m_Offset);
+	(void)again;
+	assert(layout.Find<int>("ammo").m_Index == ammo.m_Index);
+	assert(!layout.Find<float>("ammo").IsValid());
+	assert(!layout.Find<int>("none").IsValid());
+	assert(target.m_Offset % alignof(SBlackboardPoint) == 0);
+
+	// дֻǰƫƷ,дֵͬı
+	CBlackboard blackboard;
+	blackboard.Reset(layout);
+	assert(blackboard.Get(ammo) == 3);
+	assert(blackboard.Get(health) == 1.0f);
+	blackboard.Set(ammo, 3);
+	assert(blackboard.GetVersion(ammo.m_Index) == 0);
+	SBlackboardPoint point = { 1.0f, 2.0f };
+	blackboard.Set(target, point);
+	assert(blackboard.Get(target).m_Y == 2.0f);
+	assert(blackboard.GetVersion(target.m_Index) == 1);
+
+	// ¼: ȴڵ㲻ڵȶ,ڰıʱֱ
+	CBehaviorTree bt;
+	bt.GetBlackboard().Reset(layout);
+	CBehaviorAllocate t;
+	CBlackboardWaitNode<bool> &wait = t.allocate<CBlackboardWaitNode<bool> >(alarm, CMP_EQUAL, true);
+	SObserverRecord record = { 0, BH_INVALID };
+	BehaviorObserver observer = BehaviorObserver::Bind<SObserverRecord, &SObserverRecord::OnComplete>(&record);
+	CBehavior b(wait, &bt);
+	bt.Start(b, &observer);
+	bt.Tick();
+	assert(bt.GetScheduledCount() == 0);
+	assert(record.m_Called == 0);
+	bt.GetBlackboard().Set(alarm, true);
+	assert(record.m_Called == 1 && record.m_Status == BH_SUCCESS);
+
+	// ֹյ֪ͨ
+	bt.GetBlackboard().Set(alarm, false);
+	bt.Start(b, &observer);
+	b.Abort();
+	bt.GetBlackboard().Set(alarm, true);
+	assert(record.m_Called == 1);
+
+	// ʱճŶ
+	bt.Start(b, &observer);
+	bt.Tick();
+	assert(record.m_Called == 2 && b.GetStatus() == BH_SUCCESS);
+
+	// ѯ
+	CBlackboardWaitNode<int> &low = t.allocate<CBlackboardWaitNode<int> >(ammo, CMP_LESS, 2);
+	CBehavior c(low, &bt);
+	eStatus s = c.Tick();
+	assert(s == BH_RUNNING);
+	bt.GetBlackboard().Set(ammo, 1);
+	s = c.Tick();
+	assert(s == BH_SUCCESS);
+	(void)s;
+}
+
+template <class T>
+class CBlackboardConditionTask;
+
+// ڰ: Ƚϳʱpass,ʧ
+// passȡBH_RUNNINGʱڼһֱ,Ϊ
+template <class T>
+struct CBlackboardConditionNode :public CNode
+{
+	CBlackboardConditionNode(SBlackboardKey<T> key, eCompare compare, const T &value, eStatus pass = BH_SUCCESS) :
+		m_Key(key),
+		m_Dependency(key.m_Index),
+		m_Compare(compare),
+		m_Pass(pass),
+		m_Value(value)
+	{
+	}
+
+	virtual CTask *Create(CBehaviorTree *bt)
+	{
+		return CreateTask<CBlackboardConditionTask<T> >(*this, bt);
+	}
+
+	virtual void Destroy(CTask *task)
+	{
+		DestroyTask<CBlackboardConditionTask<T> >(task);
+	}
+
+	virtual void Measure(STaskDemand &demand) const
+	{
+		demand.Add<CBlackboardConditionTask<T> >();
+	}
+
+	virtual bool GetDependencies(SDependencies &dependencies) const
+	{
+		dependencies.m_Keys = &m_Dependency;
+		dependencies.m_Count = 1;
+		return true;
+	}
+
+	SBlackboardKey<T> m_Key;
+	uint16_t m_Dependency;
+	eCompare m_Compare;
+	eStatus m_Pass;
+	T m_Value;
+};
+
+template <class T>
+class CBlackboardConditionTask :public CTask
+{
+public:
+	CBlackboardConditionTask(CNode &node) :
+		CTask(node)
+	{
+	}
+
+	typedef CBlackboardConditionTask Self;
+	typedef CTask Base;
+
+	virtual eStatus Update()
+	{
+		CBlackboardConditionNode<T> &node = *static_cast<CBlackboardConditionNode<T> *>(m_Node);
+		const T &value = m_BehaviorTree->GetBlackboard().Get(node.m_Key);
+		return Compare(node.m_Compare, value, node.m_Value) ? node.m_Pass : BH_FAILURE;
+	}
+};
+
+// ¼ֵ
+struct CCountedConditionTask :public CBlackboardConditionTask<bool>
+{
+	CCountedConditionTask(CNode &node) :
+		CBlackboardConditionTask<bool>(node)
+	{
+	}
+
+	typedef CCountedConditionTask Self;
+	typedef CBlackboardConditionTask<bool> Base;
+
+	virtual eStatus Update();
+};
+
+struct CCountedConditionNode :public CBlackboardConditionNode<bool>
+{
+	CCountedConditionNode(SBlackboardKey<bool> key, eStatus pass) :
+		CBlackboardConditionNode<bool>(key, CMP_EQUAL, true, pass),
+		m_UpdateCalled(0)
+	{
+	}
+
+	virtual CTask *Create(CBehaviorTree *bt)
+	{
+		return CreateTask<CCountedConditionTask>(*this, bt);
+	}
+
+	virtual void Destroy(CTask *task)
+	{
+		DestroyTask<CCountedConditionTask>(task);
+	}
+
+	virtual void Measure(STaskDemand &demand) const
+	{
+		demand.Add<CCountedConditionTask>();
+	}
+
+	int m_UpdateCalled;
+};
+
+eStatus CCountedConditionTask::Update()
+{
+	++static_cast<CCountedConditionNode *>(m_Node)->m_UpdateCalled;
+	return CBlackboardConditionTask<bool>::Update();
+}
+
+void testreactive()
+{
+	CBlackboardLayout layout;
+	SBlackboardKey<bool> enemy = layout.Declare<bool>("enemy");
+	SBlackboardKey<int> noise = layout.Declare<int>("noise");
+
+	CBehaviorTree bt;
+	bt.GetBlackboard().Reset(layout);
+	CBehaviorAllocate t;
+
+	// ѡ: ȼ֧ʧܺ,ֻļıʱֵ
+	CCountedConditionNode &attack = t.allocate<CCountedConditionNode>(enemy, BH_RUNNING);
+	CMockActiveSelector &a = t.allocate<CMockActiveSelector>();
+	a.Reserve(t, 2);
+	a.AddChild(attack);
+	a.Initialize(t, 1);
+	bt.Prepare(a);
+	CBehavior b(a, &bt);
+
+	eStatus s = b.Tick();
+	assert(s == BH_RUNNING);
+	assert(attack.m_UpdateCalled == 1);
+	s = b.Tick();
+	assert(s == BH_RUNNING);
+	bt.GetBlackboard().Set(noise, 1);
+	s = b.Tick();
+	assert(s == BH_RUNNING);
+	assert(attack.m_UpdateCalled == 1);
+
+	// ıֵ,,ռȼ֧
+	bt.GetBlackboard().Set(enemy, true);
+	s = b.Tick();
+	assert(s == BH_RUNNING);
+	assert(attack.m_UpdateCalled == 2);
+	s = b.Tick();
+	assert(s == BH_RUNNING);
+	assert(attack.m_UpdateCalled == 3);
+
+	// ٳ,صȼ֧
+	bt.GetBlackboard().Set(enemy, false);
+	s = b.Tick();
+	assert(s == BH_RUNNING);
+	assert(attack.m_UpdateCalled == 4);
+	s = b.Tick();
+	assert(s == BH_RUNNING);
+	assert(attack.m_UpdateCalled == 4);
+	assert(bt.GetTaskPool().GetMisses() == 0);
+
+	// : ûʱTick
+	CCountedConditionNode &guard = t.allocate<CCountedConditionNode>(enemy, BH_RUNNING);
+	CMockMonitor &m = t.allocate<CMockMonitor>();
+	m.Reserve(t, 2);
+	m.AddChild(guard);
+	m.Initialize(t, 1);
+	bt.GetBlackboard().Set(enemy, true);
+	CBehavior c(m, &bt);
+	s = c.Tick();
+	assert(s == BH_RUNNING);
+	s = c.Tick();
+	assert(s == BH_RUNNING);
+	assert(guard.m_UpdateCalled == 1);
+	assert(c.Get<CParallel>()->GetBehavior(1).Get<CMockTask>()->m_UpdateCalled == 2);
+	bt.GetBlackboard().Set(enemy, false);
+	s = c.Tick();
+	assert(s == BH_FAILURE);
+	assert(guard.m_UpdateCalled == 2);
+
+	// ʱ,ͬ汾
+	const int k_Guards = 10;
+	CCountedConditionNode *guards[k_Guards];
+	CMockMonitor &wm = t.allocate<CMockMonitor>();
+	wm.Reserve(t, k_Guards + 1);
+	for (int i = 0; i < k_Guards; ++i)
+	{
+		guards[i] = &t.allocate<CCountedConditionNode>(enemy, BH_RUNNING);
+		wm.AddChild(*guards[i]);
+	}
+	wm.Initialize(t, 1);
+	bt.GetBlackboard().Set(enemy, true);
+	CBehavior d(wm, &bt);
+	for (int frame = 0; frame < 3; ++frame)
+	{
+		s = d.Tick();
+		assert(s == BH_RUNNING);
+	}
+	for (int i = 0; i < k_Guards; ++i)
+	{
+		assert(guards[i]->m_UpdateCalled == 1);
+	}
+
+	CCountedConditionNode *branches[k_Guards];
+	CMockActiveSelector &wa = t.allocate<CMockActiveSelector>();
+	wa.Reserve(t, k_Guards + 1);
+	for (int i = 0; i < k_Guards; ++i)
+	{
+		branches[i] = &t.allocate<CCountedConditionNode>(enemy, BH_RUNNING);
+		wa.AddChild(*branches[i]);
+	}
+	wa.Initialize(t, 1);
+	bt.GetBlackboard().Set(enemy, false);
+	CBehavior e(wa, &bt);
+	for (int frame = 0; frame < 3; ++frame)
+	{
+		s = e.Tick();
+		assert(s == BH_RUNNING);
+		bt.GetBlackboard().Set(noise, frame);
+	}
+	for (int i = 0; i < k_Guards; ++i)
+	{
+		assert(branches[i]->m_UpdateCalled == 1);
+	}
+	(void)s;
+}
+
+// ͬһ,Ա
+struct CUndeclaredConditionNode :public CBlackboardConditionNode<bool>
+{
+	CUndeclaredConditionNode(SBlackboardKey<bool> key) :
+		CBlackboardConditionNode<bool>(key, CMP_EQUAL, true)
+	{
+	}
+
+	virtual bool GetDependencies(SDependencies &) const
+	{
+		return false;
+	}
+};
+
+// ѡǰɸ֧,һ֧һֱ
+void benchreactive()
+{
+	const size_t k_Agents = 1000;
+	const int k_Frames = 1000;
+	const int k_Conditions = 6;
+
+	CBlackboardLayout layout;
+	SBlackboardKey<bool> keys[k_Conditions];
+	for (int i = 0; i < k_Conditions; ++i)
+	{
+		char name[16];
+		snprintf(name, sizeof(name), "flag%d", i);
+		keys[i] = layout.Declare<bool>(name);
+	}
+
+	for (int declared = 0; declared < 2; ++declared)
+	{
+		CBehaviorAllocate t;
+		CMockActiveSelector &root = t.allocate<CMockActiveSelector>();
+		root.Reserve(t, k_Conditions + 1);
+		for (int i = 0; i < k_Conditions; ++i)
+		{
+			if (declared)
+			{
+				root.AddChild(t.allocate<CBlackboardConditionNode<bool> >(keys[i], CMP_EQUAL, true));
+			}
+			else
+			{
+				root.AddChild(t.allocate<CUndeclaredConditionNode>(keys[i]));
+			}
+		}
+		root.AddChild(t.allocate<CWaitNode>(k_Frames * 2));
+
+		std::deque<CBehaviorTree> trees(k_Agents);
+		std::deque<CBehavior> behaviors(k_Agents);
+		for (size_t i = 0; i < k_Agents; ++i)
+		{
+			trees[i].GetBlackboard().Reset(layout);
+			trees[i].Prepare(root);
+			behaviors[i].Setup(root, &trees[i]);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < k_Frames; ++frame)
+		{
+			for (size_t i = 0; i < k_Agents; ++i)
+			{
+				behaviors[i].Tick();
+			}
+		}
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (k_Agents * k_Frames);
+
+		printf("reactive conditions=%d declared=%d %.1fns/tick\n", k_Conditions, declared, ns);
+	}
+}
+
+// ڵ֡ع,öʱ,ڵٴTickƽ
+struct CHoldTask :public CTask
+{
+	CHoldTask(CNode &node) :
+		CTask(node),
+		m_Remaining(0)
+	{
+	}
+
+	typedef CHoldTask Self;
+	typedef CTask Base;
+
+	virtual void OnInitialize()
+	{
+		m_Remaining = static_cast<CWaitNode *>(m_Node)->m_Ticks;
+	}
+
+	virtual eStatus Update()
+	{
+		return m_Remaining-- > 0 ? BH_SUSPENDED : BH_SUCCESS;
+	}
+
+	uint32_t m_Remaining;
+};
+
+struct CHoldNode :public CWaitNode
+{
+	CHoldNode(uint32_t ticks) :
+		CWaitNode(ticks, BH_SUCCESS)
+	{
+	}
+
+	virtual CTask *Create(CBehaviorTree *bt)
+	{
+		return CreateTask<CHoldTask>(*this, bt);
+	}
+
+	virtual void Destroy(CTask *task)
+	{
+		DestroyTask<CHoldTask>(task);
+	}
+};
+
+// ȴⲿ¼,UpdateʱµǰΪ,¼ʱⲿResume
+struct CEventTask :public CTask
+{
+	CEventTask(CNode &node) :
+		CTask(node),
+		m_Owner(nullptr),
+		m_Signaled(false)
+	{
+	}
+
+	typedef CEventTask Self;
+	typedef CTask Base;
+
+	virtual eStatus Update()
+	{
+		if (m_Signaled)
+		{
+			return BH_SUCCESS;
+		}
+		m_Owner = m_BehaviorTree->GetCurrent();
+		return BH_SUSPENDED;
+	}
+
+	CBehavior *m_Owner;
+	bool m_Signaled;
+};
+
+struct CEventNode :public CNode
+{
+	virtual CTask *Create(CBehaviorTree *bt)
+	{
+		return CreateTask<CEventTask>(*this, bt);
+	}
+
+	virtual void Destroy(CTask *task)
+	{
+		DestroyTask<CEventTask>(task);
+	}
+};
+
+void testsuspend()
+{
+	// ʱ: һȦһǰ֡֡
+	CTimerWheel wheel;
+	CTimer timers[3];
+	CBehavior behaviors[3];
+	wheel.Add(timers[0], 3, &behaviors[0]);
+	wheel.Add(timers[1], 64, &behaviors[1]);
+	wheel.Add(timers[2], 130, &behaviors[2]);
+	std::vector<CBehavior *> fired;
+	auto fire = [&](CBehavior *behavior) { fired.push_back(behavior); };
+	wheel.Advance(2, fire);
+	assert(fired.empty());
+	wheel.Advance(1, fire);
+	assert(fired.size() == 1 && fired[0] == &behaviors[0]);
+	wheel.Advance(60, fire);
+	assert(fired.size() == 1);
+	wheel.Advance(1, fire);
+	assert(fired.size() == 2 && fired[1] == &behaviors[1]);
+	wheel.Advance(200, fire);
+	assert(fired.size() == 3 && wheel.GetCount() == 0);
+
+	// ¼: ҶӲڵȶ,ںŻ
+	CSleepNode sleep(5, BH_SUCCESS);
+	CBehaviorTree bt;
+	bt.Prepare(sleep);
+	CBehavior b(sleep, &bt);
+	SObserverRecord record = { 0, BH_INVALID };
+	BehaviorObserver observer = BehaviorObserver::Bind<SObserverRecord, &SObserverRecord::OnComplete>(&record);
+	bt.Start(b, &observer);
+	bt.Tick();
+	assert(b.IsSuspended());
+	assert(bt.GetScheduledCount() == 0);
+	for (int frame = 0; frame < 4; ++frame)
+	{
+		bt.Tick();
+		assert(record.m_Called == 0);
+	}
+	bt.Tick();
+	assert(record.m_Called == 1 && record.m_Status == BH_SUCCESS);
+
+	// ֹʱȡʱ
+	bt.Start(b, &observer);
+	bt.Tick();
+	assert(bt.GetTimerCount() == 1);
+	b.Abort();
+	assert(bt.GetTimerCount() == 0);
+
+	// StepִʱûпԻָΪ,ֱʧ
+	CBehavior orphan(sleep);
+	eStatus s = orphan.Tick();
+	assert(s == BH_FAILURE);
+	CBehavior outside(sleep, &bt);
+	s = outside.Tick();
+	assert(s == BH_FAILURE && bt.GetTimerCount() == 0);
+
+	// ѯ: ѡķ֧ʱԼڶ,֡ʱͬ
+	int clock = 0;
+	CBehaviorAllocate t;
+	CMockActiveSelector &a = t.allocate<CMockActiveSelector>();
+	a.Reserve(t, 2);
+	a.AddChild(t.allocate<CClockNode>(clock, 1, 2, BH_SUCCESS));
+	a.AddChild(t.allocate<CSleepNode>(3, BH_SUCCESS));
+	a.Initialize(t, 1);
+	bt.Prepare(a);
+	CBehavior c(a, &bt);
+	record.m_Called = 0;
+	bt.Start(c, &observer);
+	bt.Tick();
+	assert(c.GetStatus() == BH_RUNNING && bt.GetScheduledCount() == 1 && bt.GetTimerCount() == 1);
+	bt.Tick();
+	bt.Tick();
+	assert(record.m_Called == 0);
+	bt.Tick();
+	assert(record.m_Called == 1 && record.m_Status == BH_SUCCESS);
+
+	// ֧ʱȼ֧ܽӹ,ķֹ֧ȡʱ
+	record.m_Called = 0;
+	bt.Start(c, &observer);
+	bt.Tick();
+	assert(bt.GetTimerCount() == 1);
+	clock = 1;
+	bt.Tick();
+	assert(record.m_Called == 1 && record.m_Status == BH_SUCCESS && bt.GetTimerCount() == 0);
+
+	// ظڵ: ӽڵʱӽڵ㲢ع,ÿֻһʱ
+	CMockRepeat &r = t.allocate<CMockRepeat>(&t.allocate<CSleepNode>(5, BH_SUCCESS));
+	r.SetParam(3);
+	bt.Prepare(r);
+	CBehavior e(r, &bt);
+	record.m_Called = 0;
+	bt.Start(e, &observer);
+	for (int frame = 0; frame < 15; ++frame)
+	{
+		bt.Tick();
+		assert(e.IsSuspended() && bt.GetTimerCount() == 1 && record.m_Called == 0);
+	}
+	bt.Tick();
+	assert(record.m_Called == 1 && record.m_Status == BH_SUCCESS && bt.GetTimerCount() == 0);
+
+	// ƽִCBehaviorͬ,ӽڵ㲻³ʼ
+	CMockSequence &hs = t.allocate<CMockSequence>();
+	hs.Reserve(t, 2);
+	CMockRepeat &hr = t.allocate<CMockRepeat>(&t.allocate<CHoldNode>(2));
+	hr.SetParam(3);
+	hs.AddChild(hr);
+	hs.AddChild(t.allocate<CHoldNode>(1));
+	CFlatTree flat;
+	flat.Build(hs);
+	CFlatAgent agent(flat);
+	CBehavior h(hs);
+	for (int frame = 0; frame < 20; ++frame)
+	{
+		eStatus status = h.Tick();
+		s = agent.Tick();
+		assert(s == status);
+		assert(status == (frame % 8 == 7 ? BH_SUCCESS : BH_SUSPENDED));
+		(void)status;
+	}
+
+	// ⲿ¼
+	CEventNode event;
+	CBehavior d(event, &bt);
+	record.m_Called = 0;
+	bt.Start(d, &observer);
+	bt.Tick();
+	bt.Tick();
+	assert(d.IsSuspended() && record.m_Called == 0);
+	CEventTask *task = d.Get<CEventTask>();
+	assert(task->m_Owner == &d);
+	task->m_Signaled = true;
+	bt.Resume(*task->m_Owner);
+	bt.Tick();
+	assert(record.m_Called == 1 && record.m_Status == BH_SUCCESS);
+	(void)s;
+}
+
+// ȴͬ֡: ÿ֡ѯ͹ɶʱֻ
+void benchsleep()
+{
+	const size_t k_Agents = 10000;
+	const uint32_t k_Wait = 100;
+
+	for (int suspend = 0; suspend < 2; ++suspend)
+	{
+		CWaitNode wait(k_Wait, BH_SUCCESS);
+		CSleepNode sleep(k_Wait, BH_SUCCESS);
+		CNode &root = suspend ? static_cast<CNode &>(sleep) : static_cast<CNode &>(wait);
+
+		std::deque<CBehaviorTree> trees(k_Agents);
+		std::deque<CBehavior> behaviors(k_Agents);
+		for (size_t i = 0; i < k_Agents; ++i)
+		{
+			trees[i].Prepare(root);
+			behaviors[i].Setup(root, &trees[i]);
+			trees[i].Start(behaviors[i]);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (uint32_t frame = 0; frame < k_Wait; ++frame)
+		{
+			for (size_t i = 0; i < k_Agents; ++i)
+			{
+				trees[i].Tick();
+			}
+		}
+		double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / k_Wait;
+
+		printf("sleep agents=%d frames=%u %s=%.1fus/frame\n", static_cast<int>(k_Agents), k_Wait, suspend ? "suspended" : "polled", us);
+
+		for (size_t i = 0; i < k_Agents; ++i)
+		{
+			if (behaviors[i].IsActive())
+			{
+				behaviors[i].Abort();
+			}
+		}
+	}
+}
+
+// Ҷӽڵ
+// ͬһ֡ﱾڵĴһֵ,agentsΪ,˳дresults
+// ʹ߰֯SoA,ڵжȡ,ʺдɿѭ
+// Ҷû״̬,OnInitialize/OnTerminate
+class CBatchNode :public CNode
+{
+public:
+	virtual void Evaluate(const uint32_t *agents, size_t count, eStatus *results) const = 0;
+
+	virtual CTask *Create(CBehaviorTree *bt);
+	virtual void Destroy(CTask *task);
+	virtual void Measure(STaskDemand &demand) const;
+};
+
+// Tickʱһֵ,ѯĸڵֱTickӽڵʱ
+class CBatchTask :public CTask
+{
+public:
+	CBatchTask(CNode &node) :
+		CTask(node)
+	{
+		m_Batched = true;
+	}
+
+	typedef CBatchTask Self;
+	typedef CTask Base;
+
+	virtual eStatus Update()
+	{
+		uint32_t agent = m_BehaviorTree != nullptr ? m_BehaviorTree->GetAgentIndex() : 0;
+		eStatus result = BH_INVALID;
+		static_cast<CBatchNode *>(m_Node)->Evaluate(&agent, 1, &result);
+		return result;
+	}
+};
+
+CTask *CBatchNode::Create(CBehaviorTree *bt)
+{
+	return CreateTask<CBatchTask>(*this, bt);
+}
+
+void CBatchNode::Destroy(CTask *task)
+{
+	DestroyTask<CBatchTask>(task);
+}
+
+void CBatchNode::Measure(STaskDemand &demand) const
+{
+	demand.Add<CBatchTask>();
+}
+
+struct SBatchStats
+{
+	// EvaluateĴ
+	uint64_t m_Kernels;
+	// ֵҶ
+	uint64_t m_Leaves;
+};
+
+// 
+// ճTick,ִеȶеҶʱȼ,дTick󰴽ڵֵ
+// ,ִɴĺΪ,ֵҶ,ֱûµҶ
+// 뵥Tick,ÿһִ֡еΪ˳򶼲
+// ֻ¼ʱŽȶеҶӲŻ,ѯȻֵ
+// ¼ͽÿҶԼмʮĿ,benchbatchֻȽһξҶӷ,
+// ֵֻĿԶһ麯,ͬһڵܱһʱֵʹ
+class CBatchScheduler
+{
+public:
+	// batchedΪfalseʱҶֵ,Ա
+	CBatchScheduler(bool batched = true) :
+		m_Batched(batched)
+	{
+		m_Stats.m_Kernels = 0;
+		m_Stats.m_Leaves = 0;
+	}
+
+	// һrootĴ,Ϊӵ˳,rootһ֡¿ʼ
+	CBehaviorTree &Add(CNode &root)
+	{
+		uint32_t index = static_cast<uint32_t>(m_Agents.size());
+		m_Agents.emplace_back();
+		SAgent &agent = m_Agents.back();
+		agent.m_Tree.Prepare(root);
+		agent.m_Tree.SetAgentIndex(index);
+		if (m_Batched)
+		{
+			agent.m_Tree.SetBatcher(this);
+		}
+		agent.m_Behavior.Setup(root, &agent.m_Tree);
+		agent.m_Finished = true;
+		return agent.m_Tree;
+	}
+
+	void Tick()
+	{
+		for (size_t i = 0; i < m_Agents.size(); ++i)
+		{
+			m_Agents[i].Tick();
+		}
+
+		while (!m_Pending.empty())
+		{
+			Flush();
+		}
+	}
+
+	size_t GetAgentCount() const
+	{
+		return m_Agents.size();
+	}
+
+	CBehavior &GetBehavior(size_t index)
+	{
+		return m_Agents[index].m_Behavior;
+	}
+
+	const SBatchStats &GetStats() const
+	{
+		return m_Stats;
+	}
+
 protected:
-	ePolicy m_SuccessPolicy;
-	ePolicy m_FailruePolicy;
-	CBehavior m_Behavior;
-};
+	friend class CBehaviorTree;
 
-typedef CMockComposite<CParallel> CMockParallel;
+	struct SAgent
+	{
+		void Tick()
+		{
+			if (m_Finished)
+			{
+				m_Finished = false;
+				BehaviorObserver observer = BehaviorObserver::Bind<SAgent, &SAgent::OnComplete>(this);
+				m_Tree.Start(m_Behavior, &observer);
+			}
+			m_Tree.Tick();
+		}
 
-void testparallel()
+		void OnComplete(eStatus)
+		{
+			m_Finished = true;
+		}
+
+		CBehaviorTree m_Tree;
+		CBehavior m_Behavior;
+		bool m_Finished;
+	};
+
+	struct SEntry
+	{
+		const CBatchNode *m_Node;
+		CBehaviorTree *m_Tree;
+		CBehavior *m_Behavior;
+	};
+
+	struct SGroup
+	{
+		const CBatchNode *m_Node;
+		size_t m_Count;
+	};
+
+	// ڵm_Entries,ͬһڵڱּ¼Ⱥ,뵥Tickʱ˳һ
+	// һ֡вͬڵ,Բҽڵ󰴼Ͱ,Ҫ
+	void Group()
+	{
+		m_Nodes.clear();
+		m_Groups.resize(m_Pending.size());
+		size_t last = 0;
+		for (size_t i = 0; i < m_Pending.size(); ++i)
+		{
+			const CBatchNode *node = m_Pending[i].m_Node;
+			if (last >= m_Nodes.size() || m_Nodes[last].m_Node != node)
+			{
+				last = 0;
+				while (last < m_Nodes.size() && m_Nodes[last].m_Node != node)
+				{
+					++last;
+				}
+				if (last == m_Nodes.size())
+				{
+					SGroup group = { node, 0 };
+					m_Nodes.push_back(group);
+				}
+			}
+			++m_Nodes[last].m_Count;
+			m_Groups[i] = static_cast<uint32_t>(last);
+		}
+
+		size_t offset = 0;
+		for (size_t i = 0; i < m_Nodes.size(); ++i)
+		{
+			size_t count = m_Nodes[i].m_Count;
+			m_Nodes[i].m_Count = offset;
+			offset += count;
+		}
+
+		m_Entries.resize(m_Pending.size());
+		for (size_t i = 0; i < m_Pending.size(); ++i)
+		{
+			m_Entries[m_Nodes[m_Groups[i]].m_Count++] = m_Pending[i];
+		}
+		m_Pending.clear();
+	}
+
+	void Defer(CBehaviorTree &tree, CBehavior &behavior)
+	{
+		SEntry entry = { static_cast<const CBatchNode *>(behavior.m_Node), &tree, &behavior };
+		m_Pending.push_back(entry);
+
+		if (!tree.m_BatchPending)
+		{
+			tree.m_BatchPending = true;
+			m_Touched.push_back(&tree);
+		}
+	}
+
+	void Flush()
+	{
+		m_Continuing.swap(m_Touched);
+		Group();
+
+		// Ƿڶ,ĺΪǰ,ִ֡
+		for (size_t i = 0; i < m_Continuing.size(); ++i)
+		{
+			m_Continuing[i]->m_BatchPending = false;
+			m_Continuing[i]->m_Behaviors.PushFront(nullptr);
+		}
+
+		for (size_t begin = 0; begin < m_Entries.size(); )
+		{
+			const CBatchNode *node = m_Entries[begin].m_Node;
+			size_t end = begin;
+			m_AgentIndices.clear();
+			while (end < m_Entries.size() && m_Entries[end].m_Node == node)
+			{
+				m_AgentIndices.push_back(m_Entries[end].m_Tree->GetAgentIndex());
+				++end;
+			}
+
+			m_Results.resize(m_AgentIndices.size());
+			node->Evaluate(&m_AgentIndices[0], m_AgentIndices.size(), &m_Results[0]);
+			++m_Stats.m_Kernels;
+			m_Stats.m_Leaves += m_AgentIndices.size();
+
+			for (size_t i = begin; i < end; ++i)
+			{
+				m_Entries[i].m_Behavior->m_Status = m_Results[i - begin];
+				m_Entries[i].m_Tree->Finish(*m_Entries[i].m_Behavior);
+			}
+			begin = end;
+		}
+		m_Entries.clear();
+
+		for (size_t i = 0; i < m_Continuing.size(); ++i)
+		{
+			while (m_Continuing[i]->Step())
+			{
+				continue;
+			}
+		}
+		m_Continuing.clear();
+	}
+
+	bool m_Batched;
+	std::deque<SAgent> m_Agents;
+	std::vector<SEntry> m_Pending;
+	std::vector<SEntry> m_Entries;
+	std::vector<SGroup> m_Nodes;
+	std::vector<uint32_t> m_Groups;
+	std::vector<CBehaviorTree *> m_Touched;
+	std::vector<CBehaviorTree *> m_Continuing;
+	std::vector<uint32_t> m_AgentIndices;
+	std::vector<eStatus> m_Results;
+	SBatchStats m_Stats;
+};
+
+void CBehaviorTree::Defer(CBehavior &b)
 {
-	CBehaviorTree bt;
-	CBehaviorAllocate t;
-	CMockParallel &p = t.allocate<CMockParallel>();
-	p.Initialize(bt, t, 2);
-	CBehavior b(p);
-	b.Get<CParallel>()->SetPolicy(CParallel::RequireAll, CParallel::RequireOne);
-	bt.Start(b);
-	bt.Tick();
+	m_Batcher->Defer(*this, b);
 }
 
-// 
-// ΪнڵӼ
-class CMonitor :public CParallel
+// õĴ,ŴŵSoA
+struct SAgentColumns
 {
-public:
-	CMonitor(CComposite &node) :CParallel(node, CParallel::RequireOne, CParallel::RequireOne) {}
+	std::vector<float> m_X;
+	std::vector<float> m_Y;
+	std::vector<float> m_Health;
+};
 
-	// ӿʼ
-	void AddCondition(CNode &condition)
+// Ŀ㲻뾶ʱɹ
+// Ȱռ,ûз֧ѭֵ,
+struct CInRangeNode :public CBatchNode
+{
+	CInRangeNode(const SAgentColumns &columns, float x, float y, float radius) :
+		m_Columns(&columns),
+		m_X(x),
+		m_Y(y),
+		m_Radius2(radius * radius)
 	{
-		GetNode().AddChildFront(condition);
 	}
 
-	// Ӷ
-	void AddAction(CNode &action)
+	virtual void Evaluate(const uint32_t *agents, size_t count, eStatus *results) const
 	{
-		GetNode().AddChild(action);
+		const size_t k_Chunk = 64;
+		float dx[k_Chunk], dy[k_Chunk];
+		for (size_t begin = 0; begin < count; begin += k_Chunk)
+		{
+			size_t n = count - begin < k_Chunk ? count - begin : k_Chunk;
+			for (size_t i = 0; i < n; ++i)
+			{
+				dx[i] = m_Columns->m_X[agents[begin + i]];
+				dy[i] = m_Columns->m_Y[agents[begin + i]];
+			}
+			for (size_t i = 0; i < n; ++i)
+			{
+				float x = dx[i] - m_X;
+				float y = dy[i] - m_Y;
+				results[begin + i] = x * x + y * y <= m_Radius2 ? BH_SUCCESS : BH_FAILURE;
+			}
+		}
 	}
+
+	const SAgentColumns *m_Columns;
+	float m_X;
+	float m_Y;
+	float m_Radius2;
 };
 
-typedef CMockComposite<CMonitor> CMockMonitor;
+// ֵֵʱɹ
+struct CLowHealthNode :public CBatchNode
+{
+	CLowHealthNode(const SAgentColumns &columns, float threshold) :
+		m_Columns(&columns),
+		m_Threshold(threshold)
+	{
+	}
 
-void testmonitor()
+	virtual void Evaluate(const uint32_t *agents, size_t count, eStatus *results) const
+	{
+		const float *health = &m_Columns->m_Health[0];
+		for (size_t i = 0; i < count; ++i)
+		{
+			results[i] = health[agents[i]] < m_Threshold ? BH_SUCCESS : BH_FAILURE;
+		}
+	}
+
+	const SAgentColumns *m_Columns;
+	float m_Threshold;
+};
+
+// ѡ[[ڷΧ, ], ȴ1֡]
+CNode &buildbatchtree(CBehaviorAllocate &t, const SAgentColumns &columns)
 {
-	CBehaviorTree bt;
+	CMockSequence &flee = t.allocate<CMockSequence>();
+	flee.Reserve(t, 2);
+	flee.AddChild(t.allocate<CInRangeNode>(columns, 0.0f, 0.0f, 10.0f));
+	flee.AddChild(t.allocate<CLowHealthNode>(columns, 0.5f));
+
+	CMockSelector &root = t.allocate<CMockSelector>();
+	root.Reserve(t, 2);
+	root.AddChild(flee);
+	root.AddChild(t.allocate<CWaitNode>(1, BH_SUCCESS));
+	return root;
+}
+
+void makecolumns(SAgentColumns &columns, size_t agents)
+{
+	columns.m_X.resize(agents);
+	columns.m_Y.resize(agents);
+	columns.m_Health.resize(agents);
+	for (size_t i = 0; i < agents; ++i)
+	{
+		columns.m_X[i] = static_cast<float>(i % 29);
+		columns.m_Y[i] = static_cast<float>(i % 7);
+		columns.m_Health[i] = static_cast<float>(i % 10) / 10.0f;
+	}
+}
+
+// ֵֵÿ֡ÿ״̬һ
+void testbatch()
+{
+	const size_t k_Agents = 100;
+	SAgentColumns columns;
+	makecolumns(columns, k_Agents);
+
 	CBehaviorAllocate t;
-	CMockMonitor &m = t.allocate<CMockMonitor>();
-	m.Initialize(bt, t, 2);
-	CBehavior b(m);
-	bt.Start(b);
-	bt.Tick();
+	CNode &root = buildbatchtree(t, columns);
+	CBatchScheduler batched(true);
+	CBatchScheduler single(false);
+	for (size_t i = 0; i < k_Agents; ++i)
+	{
+		batched.Add(root);
+		single.Add(root);
+	}
+
+	for (int frame = 0; frame < 10; ++frame)
+	{
+		batched.Tick();
+		single.Tick();
+		for (size_t i = 0; i < k_Agents; ++i)
+		{
+			assert(batched.GetBehavior(i).GetStatus() == single.GetBehavior(i).GetStatus());
+		}
+
+		// ı,һ֡Ľ֮ı
+		columns.m_Health[frame] = 0.0f;
+	}
+
+	// ͬһڵÿֵֻһ
+	const SBatchStats &stats = batched.GetStats();
+	(void)stats;
+	assert(stats.m_Leaves > stats.m_Kernels * 10);
+	assert(single.GetStats().m_Kernels == 0);
 }
 
-// ѡ
-class CActiveSelector :public CSelector
+// ÿ֡ÿĺʱ,ֵֵ
+void benchbatch()
 {
-public:
-	CActiveSelector(CComposite &node) :
-		CSelector(node)
+	const size_t k_Agents = 10000;
+	const int k_Frames = 200;
+	SAgentColumns columns;
+	makecolumns(columns, k_Agents);
+
+	CBehaviorAllocate t;
+	CNode &root = buildbatchtree(t, columns);
+	for (int batched = 0; batched < 2; ++batched)
 	{
+		CBatchScheduler scheduler(batched != 0);
+		for (size_t i = 0; i < k_Agents; ++i)
+		{
+			scheduler.Add(root);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < k_Frames; ++frame)
+		{
+			scheduler.Tick();
+		}
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (k_Agents * k_Frames);
+
+		const SBatchStats &stats = scheduler.GetStats();
+		printf("batch agents=%d batched=%d %.1fns/agent kernels=%llu leaves/kernel=%.1f\n", static_cast<int>(k_Agents), batched, ns,
+			static_cast<unsigned long long>(stats.m_Kernels), stats.m_Kernels != 0 ? static_cast<double>(stats.m_Leaves) / stats.m_Kernels : 0.0);
 	}
+}
 
-protected:
-	virtual void OnInitialize()
+// ̬õĴݺҶ
+struct SCombat
+{
+	bool m_Enemy;
+	int m_Ammo;
+	int m_Shots;
+	int m_Reloads;
+	int m_Aborted;
+};
+
+struct CHasEnemy
+{
+	bool operator()(SCombat &combat) const
 	{
-		m_CurrentIndex = GetNode().GetChildCount();
+		return combat.m_Enemy;
 	}
+};
 
-	virtual eStatus Update()
+struct CShoot :public CStaticTask
+{
+	eStatus Update(SCombat &combat)
 	{
-		uint16_t previous = m_CurrentIndex;
+		if (combat.m_Ammo == 0)
+		{
+			return BH_FAILURE;
+		}
+		--combat.m_Ammo;
+		++combat.m_Shots;
+		return BH_SUCCESS;
+	}
+};
 
-		// ÿζӵһӽڵ㿪ʼ
-		CSelector::OnInitialize();
-		eStatus result = CSelector::Update();
+// ÿװҪTick
+struct CReload :public CStaticTask
+{
+	void OnInitialize(SCombat &)
+	{
+		m_Ticks = 0;
+	}
 
-		// ϸڵЧ,ҵǰڵ㲻ϸڵʱ,ϸڵ
-		if (previous != GetNode().GetChildCount() && m_CurrentIndex != previous)
+	eStatus Update(SCombat &combat)
+	{
+		if (++m_Ticks < 2)
 		{
-			m_CurrentBehavior.Setup(GetNode().GetChild(previous));
-			m_CurrentBehavior.Abort();
+			return BH_RUNNING;
 		}
-		//صǰڵ״̬
-		return result;
+		++combat.m_Ammo;
+		++combat.m_Reloads;
+		return BH_SUCCESS;
 	}
+
+	void OnTerminate(SCombat &combat, eStatus status)
+	{
+		combat.m_Aborted += status == BH_ABORTED ? 1 : 0;
+	}
+
+	int m_Ticks;
 };
 
-typedef CMockComposite<CActiveSelector> CMockActiveSelector;
+typedef Sequence<Cond<CHasEnemy>, Selector<CShoot, Repeat<CReload, 3> > > CCombatTree;
 
-void testactiveselector()
+// TICKSκɹ
+template <uint32_t TICKS>
+struct CStaticWait :public CStaticTask
+{
+	template <class CONTEXT>
+	void OnInitialize(CONTEXT &)
+	{
+		m_Remaining = TICKS;
+	}
+
+	template <class CONTEXT>
+	eStatus Update(CONTEXT &)
+	{
+		if (m_Remaining > 0)
+		{
+			--m_Remaining;
+			return BH_RUNNING;
+		}
+		return BH_SUCCESS;
+	}
+
+	uint32_t m_Remaining;
+};
+
+struct CAlways
+{
+	template <class CONTEXT>
+	bool operator()(CONTEXT &) const
+	{
+		return true;
+	}
+};
+
+struct SWaitSubtree
+{
+	CNode &operator()(CBehaviorTree &) const
+	{
+		static CWaitNode node(2, BH_SUCCESS);
+		return node;
+	}
+};
+
+void teststatic()
 {
+	SCombat combat = { true, 1, 0, 0, 0 };
+	CCombatTree tree;
+	assert(sizeof(tree) <= 32);
+
+	// ӵʱ,ûʱװ3
+	eStatus s = tree.Tick(combat);
+	assert(s == BH_SUCCESS && combat.m_Shots == 1 && combat.m_Ammo == 0);
+	s = tree.Tick(combat);
+	assert(s == BH_RUNNING);
+	s = tree.Tick(combat);
+	assert(s == BH_RUNNING && combat.m_Reloads == 1);
+	s = tree.Tick(combat);
+	assert(s == BH_RUNNING && combat.m_Reloads == 2);
+	s = tree.Tick(combat);
+	assert(s == BH_SUCCESS && combat.m_Reloads == 3 && combat.m_Ammo == 3);
+	combat.m_Enemy = false;
+	s = tree.Tick(combat);
+	assert(s == BH_FAILURE && combat.m_Shots == 1);
+
+	// жϺͷʼ
+	combat.m_Enemy = true;
+	combat.m_Ammo = 0;
+	s = tree.Tick(combat);
+	assert(s == BH_RUNNING);
+	assert(tree.GetChild<1>().GetCurrentIndex() == 1);
+	tree.Abort(combat);
+	assert(combat.m_Aborted == 1 && tree.GetCurrentIndex() == 0);
+	combat.m_Enemy = false;
+	s = tree.Tick(combat);
+	assert(s == BH_FAILURE);
+
+	// ̬Ϊ̬Ľڵ,ڲһö̬
+	CBehaviorAllocate t;
+	CMockSequence &root = t.allocate<CMockSequence>();
+	root.Reserve(t, 2);
+	root.AddChild(t.allocate<CStaticTreeNode<Sequence<Subtree<SWaitSubtree>, Cond<CAlways>, CStaticWait<1> > > >());
+	root.AddChild(t.allocate<CWaitNode>(0, BH_SUCCESS));
+
 	CBehaviorTree bt;
+	bt.Prepare(root);
+	CBehavior b(root, &bt);
+	s = b.Tick();
+	assert(s == BH_RUNNING);
+	s = b.Tick();
+	assert(s == BH_RUNNING);
+	s = b.Tick();
+	assert(s == BH_RUNNING);
+	s = b.Tick();
+	assert(s == BH_SUCCESS);
+
+	// ûдʱ̬޷,ֱʧ
+	CBehavior orphan(root.GetChild(0));
+	s = orphan.Tick();
+	assert(s == BH_FAILURE);
+	(void)s;
+}
+
+template <int DEPTH>
+struct SStaticDeep
+{
+	typedef Sequence<typename SStaticDeep<DEPTH - 1>::Type> Type;
+};
+
+template <>
+struct SStaticDeep<0>
+{
+	typedef CStaticWait<4> Type;
+};
+
+// ͬ״ľ̬붯̬ÿTickĺʱ
+template <int DEPTH>
+void benchstaticdepth()
+{
+	const size_t k_Agents = 10000;
+	const int k_Frames = 200;
+
 	CBehaviorAllocate t;
-	CMockActiveSelector &a = t.allocate<CMockActiveSelector>();
-	a.Initialize(bt, t, 2);
-	CBehavior b(a);
-	bt.Start(b);
-	bt.Tick();
+	CNode &root = builddeeptree(t, DEPTH, 4);
+	std::deque<CBehaviorTree> trees(k_Agents);
+	std::deque<CBehavior> behaviors(k_Agents);
+	for (size_t i = 0; i < k_Agents; ++i)
+	{
+		trees[i].Prepare(root);
+		behaviors[i].Setup(root, &trees[i]);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < k_Frames; ++frame)
+	{
+		for (size_t i = 0; i < k_Agents; ++i)
+		{
+			behaviors[i].Tick();
+		}
+	}
+	double dynamicNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (k_Agents * k_Frames);
+
+	int context = 0;
+	std::vector<typename SStaticDeep<DEPTH>::Type> agents(k_Agents);
+	start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < k_Frames; ++frame)
+	{
+		for (size_t i = 0; i < k_Agents; ++i)
+		{
+			agents[i].Tick(context);
+		}
+	}
+	double staticNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (k_Agents * k_Frames);
+
+	printf("static depth=%d dynamic=%.1fns/tick static=%.1fns/tick state=%zuB\n", DEPTH, dynamicNs, staticNs, sizeof(typename SStaticDeep<DEPTH>::Type));
+}
+
+void benchstatic()
+{
+	benchstaticdepth<4>();
+	benchstaticdepth<16>();
+}
+
+#if BH_PROFILE
+void testprofiler()
+{
+	CBehaviorAllocate t;
+	CNode &root = buildwaittree(t);
+	CComposite &sequence = static_cast<CComposite &>(root);
+	CComposite &selector = static_cast<CComposite &>(sequence.GetChild(1));
+
+	CProfiler profiler;
+	CProfiler::SetCurrent(&profiler);
+	int frames = 0;
+	{
+		CBehavior b(root);
+		while (b.Tick() == BH_RUNNING)
+		{
+			++frames;
+		}
+		++frames;
+	}
+	CProfiler::SetCurrent(nullptr);
+
+	SNodeProfile r = profiler.Get(root);
+	assert(r.m_Calls == static_cast<uint64_t>(frames));
+	assert(r.m_Status[BH_RUNNING] == r.m_Calls - 1 && r.m_Status[BH_SUCCESS] == 1);
+	assert(r.m_Created == 1 && r.m_Destroyed == 1);
+	assert(r.m_Exclusive <= r.m_Inclusive);
+
+	// ӽڵĺʱڸڵ
+	uint64_t children = 0;
+	for (uint16_t i = 0; i < sequence.GetChildCount(); ++i)
+	{
+		SNodeProfile c = profiler.Get(sequence.GetChild(i));
+		assert(c.m_Created == c.m_Destroyed);
+		children += c.m_Inclusive;
+	}
+	assert(children <= r.m_Inclusive);
+	assert(profiler.Get(selector.GetChild(0)).m_Status[BH_FAILURE] == 1);
+
+	CProfiler merged;
+	merged.Merge(profiler);
+	merged.Merge(profiler);
+	assert(merged.Get(root).m_Calls == r.m_Calls * 2);
+
+	FILE *file = tmpfile();
+	profiler.DumpCSV(file, root);
+	profiler.DumpJSON(file, root);
+	rewind(file);
+	char line[1024];
+	int lines = 0;
+	while (fgets(line, sizeof(line), file) != nullptr)
+	{
+		++lines;
+	}
+	fclose(file);
+	// ͷ10ڵ,JSONż10ڵ
+	assert(lines == 11 + 12);
 }
+#endif
 
-int main()
+int main(int argc, char *argv[])
 {
 	test();
 	testrepeat();
@@ -847,5 +9184,45 @@ int main()
 	testparallel();
 	testmonitor();
 	testactiveselector();
+	testtasktype();
+	testtaskpool();
+	testallocate();
+	testwidecomposite();
+	testflat();
+	testtreeimage();
+	testtreeparser();
+	testworld();
+	testhotreload();
+	testsnapshot();
+	testbudget();
+	testtickscheduler();
+	testsuspend();
+	testbatch();
+	testringbuffer();
+	testobserver();
+	testeventdriven();
+	testparallelstate();
+	testblackboard();
+	testreactive();
+	teststatic();
+#if BH_PROFILE
+	testprofiler();
+#endif
+
+	if (argc > 1 && strcmp(argv[1], "-bench") == 0)
+	{
+		benchworld();
+		benchhotreload();
+		benchsnapshot();
+		benchscheduler();
+		benchevent();
+		benchstatic();
+		benchreactive();
+		benchtickscheduler();
+		benchsleep();
+		benchbatch();
+		benchtreeimage();
+		benchtreeparser();
+	}
 	return 0;
 }
\ No newline at end of file